@@ -0,0 +1,149 @@
+#include "buf_pool.h"
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+static const char *TAG = "BUF_POOL";
+
+struct buf_pool {
+    buf_pool_config_t config;
+    SemaphoreHandle_t lock;
+    SemaphoreHandle_t available;    // Counts buffers that may still be handed out
+    void **free_list;               // Stack of idle buffers
+    size_t free_count;
+    void **all;                     // Every buffer allocated, for destroy
+    buf_pool_stats_t stats;
+};
+
+static void *region_alloc(buf_pool_region_t region, size_t size)
+{
+    void *p = NULL;
+    switch (region) {
+        case BUF_POOL_REGION_PSRAM:
+            p = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+            if (p == NULL) {
+                ESP_LOGW(TAG, "⚠️ No PSRAM for %u byte buffer, using internal RAM", size);
+                p = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+            }
+            break;
+        case BUF_POOL_REGION_DMA:
+            p = heap_caps_malloc(size, MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
+            break;
+        case BUF_POOL_REGION_INTERNAL:
+        default:
+            p = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+            break;
+    }
+    return p;
+}
+
+buf_pool_t *buf_pool_create(const buf_pool_config_t *config)
+{
+    if (config == NULL || config->buf_size == 0 || config->max_buffers == 0) {
+        return NULL;
+    }
+
+    buf_pool_t *pool = calloc(1, sizeof(*pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->config = *config;
+    pool->stats.buf_size = config->buf_size;
+    pool->free_list = calloc(config->max_buffers, sizeof(void *));
+    pool->all = calloc(config->max_buffers, sizeof(void *));
+    pool->lock = xSemaphoreCreateMutex();
+    pool->available = xSemaphoreCreateCounting(config->max_buffers, config->max_buffers);
+
+    if (!pool->free_list || !pool->all || !pool->lock || !pool->available) {
+        buf_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void buf_pool_destroy(buf_pool_t *pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+    if (pool->all) {
+        for (size_t i = 0; i < pool->stats.allocated; i++) {
+            heap_caps_free(pool->all[i]);
+        }
+    }
+    if (pool->lock) {
+        vSemaphoreDelete(pool->lock);
+    }
+    if (pool->available) {
+        vSemaphoreDelete(pool->available);
+    }
+    free(pool->free_list);
+    free(pool->all);
+    free(pool);
+}
+
+void *buf_pool_acquire(buf_pool_t *pool, uint32_t timeout_ms)
+{
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    // Fast path first so we can tell a blocking acquire apart
+    bool waited = false;
+    if (xSemaphoreTake(pool->available, 0) != pdTRUE) {
+        waited = true;
+        if (xSemaphoreTake(pool->available, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+            return NULL;
+        }
+    }
+
+    void *buf = NULL;
+    xSemaphoreTake(pool->lock, portMAX_DELAY);
+    if (pool->free_count > 0) {
+        buf = pool->free_list[--pool->free_count];
+    } else {
+        buf = region_alloc(pool->config.region, pool->config.buf_size);
+        if (buf) {
+            pool->all[pool->stats.allocated++] = buf;
+        }
+    }
+    if (buf) {
+        pool->stats.acquires++;
+        pool->stats.waits += waited;
+        if (++pool->stats.in_use > pool->stats.high_water) {
+            pool->stats.high_water = pool->stats.in_use;
+        }
+    }
+    xSemaphoreGive(pool->lock);
+
+    if (buf == NULL) {
+        ESP_LOGE(TAG, "❌ Failed to allocate %u byte buffer", pool->config.buf_size);
+        xSemaphoreGive(pool->available);
+    }
+    return buf;
+}
+
+void buf_pool_release(buf_pool_t *pool, void *buf)
+{
+    if (pool == NULL || buf == NULL) {
+        return;
+    }
+    xSemaphoreTake(pool->lock, portMAX_DELAY);
+    pool->free_list[pool->free_count++] = buf;
+    pool->stats.in_use--;
+    xSemaphoreGive(pool->lock);
+    xSemaphoreGive(pool->available);
+}
+
+void buf_pool_get_stats(buf_pool_t *pool, buf_pool_stats_t *stats)
+{
+    if (pool == NULL || stats == NULL) {
+        return;
+    }
+    xSemaphoreTake(pool->lock, portMAX_DELAY);
+    *stats = pool->stats;
+    xSemaphoreGive(pool->lock);
+}
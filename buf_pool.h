@@ -0,0 +1,51 @@
+#ifndef BUF_POOL_H
+#define BUF_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Where pool buffers are carved from
+typedef enum {
+    BUF_POOL_REGION_INTERNAL,   // Internal DRAM
+    BUF_POOL_REGION_PSRAM,      // External PSRAM, falls back to internal if absent
+    BUF_POOL_REGION_DMA,        // DMA-capable internal RAM
+} buf_pool_region_t;
+
+typedef struct {
+    size_t buf_size;            // Size of every buffer handed out
+    size_t max_buffers;         // Upper bound on buffers ever allocated
+    buf_pool_region_t region;
+} buf_pool_config_t;
+
+typedef struct {
+    size_t buf_size;
+    size_t allocated;           // Buffers allocated so far (never freed until destroy)
+    size_t in_use;
+    size_t high_water;          // Max buffers in use at once
+    uint32_t acquires;
+    uint32_t waits;             // Acquires that had to block for a release
+} buf_pool_stats_t;
+
+typedef struct buf_pool buf_pool_t;
+
+// Buffers are allocated lazily on first demand and then recycled,
+// so steady-state downloads cause no heap churn.
+buf_pool_t *buf_pool_create(const buf_pool_config_t *config);
+void buf_pool_destroy(buf_pool_t *pool);
+
+// Returns NULL if no buffer became available within timeout_ms
+void *buf_pool_acquire(buf_pool_t *pool, uint32_t timeout_ms);
+void buf_pool_release(buf_pool_t *pool, void *buf);
+
+void buf_pool_get_stats(buf_pool_t *pool, buf_pool_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BUF_POOL_H
@@ -0,0 +1,418 @@
+#include "cas_store.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "hash_sink.h"
+
+static const char *TAG = "CAS";
+
+#define CAS_MAX_ENTRIES   64
+#define CAS_MAX_BLOBS     64
+#define CAS_PATH_MAX      64
+#define CAS_BLOB_NAME_LEN 16      // Hex chars of the digest used as file name (SPIFFS names are short)
+#define CAS_INDEX_FILE    "index"
+#define CAS_TEMP_FILE     "incoming"
+
+typedef struct {
+    char name[CAS_NAME_MAX];
+    uint8_t digest[CAS_DIGEST_LEN];
+} cas_entry_t;
+
+typedef struct {
+    uint8_t digest[CAS_DIGEST_LEN];
+    uint16_t refs;
+} cas_blob_t;
+
+static char base[CAS_PATH_MAX];
+static cas_entry_t entries[CAS_MAX_ENTRIES];
+static size_t entry_count = 0;
+static cas_blob_t blobs[CAS_MAX_BLOBS];
+static size_t blob_count = 0;
+static bool index_trusted = false;      // Every reference is known: compaction may delete
+
+static void to_hex(const uint8_t *in, size_t len, char *out)
+{
+    static const char hex[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++) {
+        out[2 * i] = hex[in[i] >> 4];
+        out[2 * i + 1] = hex[in[i] & 0x0f];
+    }
+    out[2 * len] = '\0';
+}
+
+static bool from_hex(const char *in, uint8_t *out, size_t len)
+{
+    for (size_t i = 0; i < 2 * len; i++) {
+        char c = in[i];
+        int v = (c >= '0' && c <= '9') ? c - '0' :
+                (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+                (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+        if (v < 0) {
+            return false;
+        }
+        out[i / 2] = (i % 2) ? (out[i / 2] | v) : (uint8_t)(v << 4);
+    }
+    return true;
+}
+
+// Only names the store itself creates may be removed from base
+static bool is_store_file(const char *name)
+{
+    if (strcmp(name, CAS_TEMP_FILE) == 0 || strcmp(name, CAS_INDEX_FILE ".tmp") == 0) {
+        return true;
+    }
+    if (strlen(name) != CAS_BLOB_NAME_LEN) {
+        return false;
+    }
+    for (const char *p = name; *p; p++) {
+        if (!((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'f'))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void blob_path(const uint8_t digest[CAS_DIGEST_LEN], char *path, size_t len)
+{
+    char hex[2 * CAS_DIGEST_LEN + 1];
+    to_hex(digest, CAS_DIGEST_LEN, hex);
+    snprintf(path, len, "%s/%.*s", base, CAS_BLOB_NAME_LEN, hex);
+}
+
+static cas_blob_t *find_blob(const uint8_t digest[CAS_DIGEST_LEN])
+{
+    for (size_t i = 0; i < blob_count; i++) {
+        if (memcmp(blobs[i].digest, digest, CAS_DIGEST_LEN) == 0) {
+            return &blobs[i];
+        }
+    }
+    return NULL;
+}
+
+static cas_entry_t *find_entry(const char *name)
+{
+    for (size_t i = 0; i < entry_count; i++) {
+        if (strcmp(entries[i].name, name) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+static cas_blob_t *add_blob(const uint8_t digest[CAS_DIGEST_LEN])
+{
+    cas_blob_t *b = find_blob(digest);
+    if (b == NULL && blob_count < CAS_MAX_BLOBS) {
+        b = &blobs[blob_count++];
+        memcpy(b->digest, digest, CAS_DIGEST_LEN);
+        b->refs = 0;
+    }
+    return b;
+}
+
+// Written to a temp file and renamed so a power cut never leaves a torn index
+static esp_err_t save_index(void)
+{
+    char path[CAS_PATH_MAX], tmp[CAS_PATH_MAX];
+    snprintf(path, sizeof(path), "%s/" CAS_INDEX_FILE, base);
+    snprintf(tmp, sizeof(tmp), "%s/" CAS_INDEX_FILE ".tmp", base);
+
+    FILE *f = fopen(tmp, "w");
+    if (!f) {
+        ESP_LOGE(TAG, "❌ Failed to write index");
+        return ESP_FAIL;
+    }
+    char hex[2 * CAS_DIGEST_LEN + 1];
+    for (size_t i = 0; i < entry_count; i++) {
+        to_hex(entries[i].digest, CAS_DIGEST_LEN, hex);
+        fprintf(f, "%s %s\n", hex, entries[i].name);
+    }
+    // On flash before the old index goes: once it is unlinked, the temp file is the index
+    bool synced = fflush(f) == 0 && fsync(fileno(f)) == 0;
+    if (fclose(f) != 0 || !synced) {
+        unlink(tmp);
+        return ESP_FAIL;
+    }
+    unlink(path);
+    return rename(tmp, path) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+// Any blob files on flash? Without an index they can't be told from garbage
+static bool store_has_blobs(void)
+{
+    DIR *dir = opendir(base);
+    if (dir == NULL) {
+        return false;
+    }
+    bool found = false;
+    struct dirent *de;
+    while (!found && (de = readdir(dir)) != NULL) {
+        found = strlen(de->d_name) == CAS_BLOB_NAME_LEN && is_store_file(de->d_name);
+    }
+    closedir(dir);
+    return found;
+}
+
+esp_err_t cas_init(const char *base_dir)
+{
+    if (base_dir == NULL || strlen(base_dir) + CAS_BLOB_NAME_LEN + 2 > sizeof(base)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // SPIFFS has no directories: opendir() matches by prefix, so the mount point
+    // itself would hand compaction every file on the partition
+    const char *last = strrchr(base_dir, '/');
+    if (base_dir[0] != '/' || last == base_dir || last[1] == '\0') {
+        ESP_LOGE(TAG, "❌ %s is not a dedicated store prefix (use e.g. /spiffs/cas)", base_dir);
+        return ESP_ERR_INVALID_ARG;
+    }
+    strcpy(base, base_dir);
+    entry_count = 0;
+    blob_count = 0;
+    index_trusted = false;
+
+    char path[CAS_PATH_MAX], tmp[CAS_PATH_MAX];
+    snprintf(path, sizeof(path), "%s/" CAS_INDEX_FILE, base);
+    snprintf(tmp, sizeof(tmp), "%s/" CAS_INDEX_FILE ".tmp", base);
+    if (access(path, F_OK) != 0 && access(tmp, F_OK) == 0) {
+        // save_index() was cut off between unlink and rename; the temp file is complete
+        ESP_LOGW(TAG, "⚠️ Recovering index from %s", tmp);
+        rename(tmp, path);
+    }
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        // A missing index over existing blobs was lost, not never written
+        index_trusted = errno == ENOENT && !store_has_blobs();
+        if (index_trusted) {
+            ESP_LOGI(TAG, "No index yet at %s", path);
+        } else {
+            ESP_LOGE(TAG, "❌ No readable index at %s but blobs exist, compaction disabled", path);
+        }
+        return ESP_OK;
+    }
+
+    // One "<hex digest> <name>" record per line
+    char line[2 * CAS_DIGEST_LEN + CAS_NAME_MAX + 4];
+    bool clean = true;
+    while (fgets(line, sizeof(line), f)) {
+        if (entry_count == CAS_MAX_ENTRIES) {
+            clean = false;
+            break;
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+        cas_entry_t *e = &entries[entry_count];
+        if (strlen(line) < 2 * CAS_DIGEST_LEN + 2 || line[2 * CAS_DIGEST_LEN] != ' ' ||
+            !from_hex(line, e->digest, CAS_DIGEST_LEN) ||
+            strlen(line + 2 * CAS_DIGEST_LEN + 1) >= CAS_NAME_MAX) {
+            ESP_LOGW(TAG, "⚠️ Skipping bad index line");
+            clean = false;
+            continue;
+        }
+        strcpy(e->name, line + 2 * CAS_DIGEST_LEN + 1);
+        cas_blob_t *b = add_blob(e->digest);
+        if (b == NULL) {
+            clean = false;
+            break;
+        }
+        b->refs++;
+        entry_count++;
+    }
+    clean = clean && !ferror(f);
+    fclose(f);
+
+    index_trusted = clean;
+    if (!clean) {
+        ESP_LOGE(TAG, "❌ Index only partly loaded, compaction disabled");
+    }
+    ESP_LOGI(TAG, "✅ Index loaded: %u names, %u blobs", (unsigned)entry_count, (unsigned)blob_count);
+    return ESP_OK;
+}
+
+bool cas_has_blob(const uint8_t digest[CAS_DIGEST_LEN])
+{
+    cas_blob_t *b = find_blob(digest);
+    if (b == NULL) {
+        return false;
+    }
+    char path[CAS_PATH_MAX];
+    blob_path(digest, path, sizeof(path));
+    return access(path, F_OK) == 0;
+}
+
+esp_err_t cas_link(const char *name, const uint8_t digest[CAS_DIGEST_LEN])
+{
+    if (name == NULL || strlen(name) >= CAS_NAME_MAX || strchr(name, '\n')) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    cas_blob_t *b = find_blob(digest);
+    if (b == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    cas_entry_t *e = find_entry(name);
+    if (e != NULL) {
+        if (memcmp(e->digest, digest, CAS_DIGEST_LEN) == 0) {
+            return ESP_OK;
+        }
+        cas_blob_t *old = find_blob(e->digest);
+        if (old && old->refs > 0) {
+            old->refs--;
+        }
+    } else {
+        if (entry_count == CAS_MAX_ENTRIES) {
+            return ESP_ERR_NO_MEM;
+        }
+        e = &entries[entry_count++];
+        strcpy(e->name, name);
+    }
+    memcpy(e->digest, digest, CAS_DIGEST_LEN);
+    b->refs++;
+    return save_index();
+}
+
+esp_err_t cas_unlink(const char *name)
+{
+    cas_entry_t *e = find_entry(name);
+    if (e == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    cas_blob_t *b = find_blob(e->digest);
+    if (b && b->refs > 0) {
+        b->refs--;
+    }
+    *e = entries[--entry_count];
+    return save_index();
+}
+
+esp_err_t cas_lookup(const char *name, char *path, size_t path_len, uint8_t digest[CAS_DIGEST_LEN])
+{
+    cas_entry_t *e = find_entry(name);
+    if (e == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (path) {
+        blob_path(e->digest, path, path_len);
+    }
+    if (digest) {
+        memcpy(digest, e->digest, CAS_DIGEST_LEN);
+    }
+    return ESP_OK;
+}
+
+esp_err_t cas_fetch(const char *name, const char *url, const uint8_t digest[CAS_DIGEST_LEN])
+{
+    if (name == NULL || url == NULL || strlen(name) >= CAS_NAME_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // 🚀 Known content: just point the name at the existing blob
+    if (digest && cas_has_blob(digest)) {
+        ESP_LOGI(TAG, "♻️ %s already stored, skipping download", name);
+        return cas_link(name, digest);
+    }
+
+    char tmp[CAS_PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s/" CAS_TEMP_FILE, base);
+    hash_sink_ctx_t hs;
+    download_sink_t sink;
+    if (hash_sink_init(&sink, &hs, tmp) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    esp_err_t ret = https_download_to_sink(&url, 1, &sink);
+    if (ret != ESP_OK) {
+        unlink(tmp);
+        return ret;
+    }
+
+    if (digest && memcmp(digest, hs.digest, CAS_DIGEST_LEN) != 0) {
+        ESP_LOGE(TAG, "❌ Digest mismatch for %s", name);
+        unlink(tmp);
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    char path[CAS_PATH_MAX];
+    blob_path(hs.digest, path, sizeof(path));
+    if (cas_has_blob(hs.digest)) {
+        // Same bytes under a different URL: keep the existing copy
+        ESP_LOGI(TAG, "♻️ %s duplicates an existing blob", name);
+        unlink(tmp);
+    } else {
+        unlink(path);
+        if (rename(tmp, path) != 0) {
+            ESP_LOGE(TAG, "❌ Failed to store blob %s", path);
+            unlink(tmp);
+            return ESP_FAIL;
+        }
+        if (add_blob(hs.digest) == NULL) {
+            ESP_LOGE(TAG, "❌ Blob table full");
+            unlink(path);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return cas_link(name, hs.digest);
+}
+
+esp_err_t cas_compact(size_t *removed)
+{
+    size_t count = 0;
+    if (removed) {
+        *removed = 0;
+    }
+    if (!index_trusted) {
+        // Blobs the lost index lines referred to would look unreferenced
+        ESP_LOGW(TAG, "⚠️ Index did not load cleanly, not deleting anything");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Drop unreferenced blobs from the table and flash
+    for (size_t i = 0; i < blob_count; ) {
+        if (blobs[i].refs == 0) {
+            char path[CAS_PATH_MAX];
+            blob_path(blobs[i].digest, path, sizeof(path));
+            if (unlink(path) == 0) {
+                count++;
+            }
+            blobs[i] = blobs[--blob_count];
+        } else {
+            i++;
+        }
+    }
+
+    // Then anything on flash the table doesn't know about (interrupted fetches)
+    DIR *dir = opendir(base);
+    if (dir) {
+        struct dirent *de;
+        char keep[CAS_MAX_BLOBS][CAS_BLOB_NAME_LEN + 1];
+        char hex[2 * CAS_DIGEST_LEN + 1];
+        for (size_t i = 0; i < blob_count; i++) {
+            to_hex(blobs[i].digest, CAS_DIGEST_LEN, hex);
+            memcpy(keep[i], hex, CAS_BLOB_NAME_LEN);
+            keep[i][CAS_BLOB_NAME_LEN] = '\0';
+        }
+        while ((de = readdir(dir)) != NULL) {
+            if (!is_store_file(de->d_name)) {
+                continue;               // Not ours, even if it shares the prefix
+            }
+            bool referenced = false;
+            for (size_t i = 0; i < blob_count && !referenced; i++) {
+                referenced = strcmp(de->d_name, keep[i]) == 0;
+            }
+            if (!referenced) {
+                char path[CAS_PATH_MAX + 32];
+                snprintf(path, sizeof(path), "%s/%s", base, de->d_name);
+                if (unlink(path) == 0) {
+                    count++;
+                }
+            }
+        }
+        closedir(dir);
+    }
+
+    ESP_LOGI(TAG, "🧹 Compaction removed %u files", (unsigned)count);
+    if (removed) {
+        *removed = count;
+    }
+    return ESP_OK;
+}
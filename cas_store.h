@@ -0,0 +1,47 @@
+#ifndef CAS_STORE_H
+#define CAS_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CAS_DIGEST_LEN    32      // SHA-256
+#define CAS_NAME_MAX      32      // Logical names, including the terminator
+
+// Content-addressed store: blobs live under base_dir named by digest, and a
+// small name -> digest index (reference counted per blob) maps logical names
+// onto them. Identical content is stored once. Not thread-safe.
+// base_dir must be a prefix only the store uses below the mount point, e.g.
+// "/spiffs/cas"; the bare mount point is rejected with ESP_ERR_INVALID_ARG.
+esp_err_t cas_init(const char *base_dir);
+
+bool cas_has_blob(const uint8_t digest[CAS_DIGEST_LEN]);
+
+// Make `name` refer to `url`'s content. If `digest` is given and already stored,
+// this only updates the index: no network, no blob write. Otherwise the content
+// is downloaded, hashed on the fly, verified against `digest` (when given) and
+// deduplicated against existing blobs.
+esp_err_t cas_fetch(const char *name, const char *url, const uint8_t digest[CAS_DIGEST_LEN]);
+
+// Bind or drop a name without downloading (blob must exist for cas_link)
+esp_err_t cas_link(const char *name, const uint8_t digest[CAS_DIGEST_LEN]);
+esp_err_t cas_unlink(const char *name);
+
+// Resolve a name to its blob file path, and optionally its digest
+esp_err_t cas_lookup(const char *name, char *path, size_t path_len, uint8_t digest[CAS_DIGEST_LEN]);
+
+// Delete blobs no name refers to (and stray temp files); returns how many.
+// Other files under base_dir are never touched. ESP_ERR_INVALID_STATE, with
+// nothing deleted, when cas_init() could not load the whole index.
+esp_err_t cas_compact(size_t *removed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CAS_STORE_H
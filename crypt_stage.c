@@ -0,0 +1,203 @@
+#include "crypt_stage.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "nvs.h"
+
+static const char *TAG = "CRYPT";
+
+#define CRYPT_MAGIC          "AEC1"
+#define CRYPT_NVS_NAMESPACE  "crypt"
+#define CRYPT_NVS_KEY        "aes256"
+
+// Position the CTR state at byte `offset` of the stream
+static void ctr_seek(mbedtls_aes_context *aes, const uint8_t nonce[CRYPT_NONCE_SIZE], size_t offset,
+                     uint8_t counter[16], uint8_t stream[16], size_t *stream_off)
+{
+    uint32_t block = offset / 16;
+    memcpy(counter, nonce, CRYPT_NONCE_SIZE);
+    counter[12] = block >> 24;
+    counter[13] = block >> 16;
+    counter[14] = block >> 8;
+    counter[15] = block;
+    *stream_off = offset % 16;
+    if (*stream_off != 0) {
+        // Mid-block: produce this block's keystream now, as crypt_ctr would have
+        mbedtls_aes_crypt_ecb(aes, MBEDTLS_AES_ENCRYPT, counter, stream);
+        for (int i = 15; i >= 0 && ++counter[i] == 0; i--) {
+        }
+    }
+}
+
+static void crypt_start(crypt_stage_ctx_t *c)
+{
+    esp_fill_random(c->nonce, sizeof(c->nonce));
+    ctr_seek(&c->aes, c->nonce, 0, c->counter, c->stream, &c->stream_off);
+    c->header_written = false;
+}
+
+static esp_err_t write_header(stage_t *s)
+{
+    crypt_stage_ctx_t *c = s->ctx;
+    uint8_t header[CRYPT_HEADER_SIZE];
+    memcpy(header, CRYPT_MAGIC, 4);
+    memcpy(header + 4, c->nonce, CRYPT_NONCE_SIZE);
+    stage_span_t span = { .data = header, .len = sizeof(header) };
+    c->header_written = true;
+    return stage_push(s->next, &span);
+}
+
+static esp_err_t crypt_push(stage_t *s, stage_span_t *span)
+{
+    crypt_stage_ctx_t *c = s->ctx;
+    if (!c->header_written) {
+        esp_err_t err = write_header(s);
+        if (err != ESP_OK) {
+            stage_span_release(span);
+            return err;
+        }
+        c->first_push_us = esp_timer_get_time();
+    }
+
+    // In place: owned segments keep travelling without a copy
+    int64_t t0 = esp_timer_get_time();
+    mbedtls_aes_crypt_ctr(&c->aes, span->len, &c->stream_off, c->counter, c->stream,
+                          span->data, span->data);
+    c->busy_us += esp_timer_get_time() - t0;
+    c->bytes += span->len;
+    return stage_push(s->next, span);
+}
+
+static esp_err_t crypt_reset(stage_t *s)
+{
+    crypt_stage_ctx_t *c = s->ctx;
+    crypt_start(c);             // Never reuse a nonce for different plaintext
+    return stage_reset(s->next);
+}
+
+static esp_err_t crypt_finish(stage_t *s)
+{
+    crypt_stage_ctx_t *c = s->ctx;
+    esp_err_t err = c->header_written ? ESP_OK : write_header(s);
+
+    int64_t elapsed = esp_timer_get_time() - c->first_push_us;
+    if (c->bytes > 0 && elapsed > 0) {
+        uint32_t pct = (uint32_t)(c->busy_us * 100 / elapsed);
+        ESP_LOGI(TAG, "🔐 Encrypted %llu bytes in %llu us (%u%% of the transfer, budget %d%%)",
+                 c->bytes, c->busy_us, (unsigned)pct, CRYPT_BUDGET_PCT);
+        if (pct > CRYPT_BUDGET_PCT) {
+            ESP_LOGW(TAG, "⚠️ Encryption overhead above budget");
+        }
+    }
+    mbedtls_aes_free(&c->aes);
+    memset(c->key, 0, sizeof(c->key));
+    if (err != ESP_OK) {
+        stage_abort(s->next);
+        return err;
+    }
+    return stage_finish(s->next);
+}
+
+static void crypt_abort(stage_t *s)
+{
+    crypt_stage_ctx_t *c = s->ctx;
+    mbedtls_aes_free(&c->aes);
+    memset(c->key, 0, sizeof(c->key));
+    stage_abort(s->next);
+}
+
+void crypt_stage_init(stage_t *s, crypt_stage_ctx_t *ctx, const uint8_t key[CRYPT_KEY_SIZE], stage_t *next)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    memcpy(ctx->key, key, CRYPT_KEY_SIZE);
+    mbedtls_aes_init(&ctx->aes);
+    mbedtls_aes_setkey_enc(&ctx->aes, ctx->key, CRYPT_KEY_SIZE * 8);   // Hardware AES on target
+    crypt_start(ctx);
+
+    *s = (stage_t) {
+        .name = "aes_ctr",
+        .push = crypt_push,
+        .finish = crypt_finish,
+        .abort = crypt_abort,
+        .reset = crypt_reset,
+        .next = next,
+        .ctx = ctx,
+    };
+}
+
+esp_err_t crypt_get_device_key(uint8_t key[CRYPT_KEY_SIZE])
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(CRYPT_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    size_t len = CRYPT_KEY_SIZE;
+    err = nvs_get_blob(nvs, CRYPT_NVS_KEY, key, &len);
+    if (err == ESP_ERR_NVS_NOT_FOUND || (err == ESP_OK && len != CRYPT_KEY_SIZE)) {
+        esp_fill_random(key, CRYPT_KEY_SIZE);
+        err = nvs_set_blob(nvs, CRYPT_NVS_KEY, key, CRYPT_KEY_SIZE);
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        ESP_LOGI(TAG, "🔑 Generated a new device key");
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+// ---- Reader ----
+
+esp_err_t crypt_reader_open(crypt_reader_t *r, const char *path, const uint8_t key[CRYPT_KEY_SIZE])
+{
+    memset(r, 0, sizeof(*r));
+    r->f = fopen(path, "rb");
+    if (r->f == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint8_t header[CRYPT_HEADER_SIZE];
+    long end = -1;
+    if (fread(header, 1, sizeof(header), r->f) != sizeof(header) ||
+        memcmp(header, CRYPT_MAGIC, 4) != 0 ||
+        fseek(r->f, 0, SEEK_END) != 0 || (end = ftell(r->f)) < CRYPT_HEADER_SIZE) {
+        ESP_LOGE(TAG, "❌ %s is not an encrypted file", path);
+        fclose(r->f);
+        r->f = NULL;
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    memcpy(r->nonce, header + 4, CRYPT_NONCE_SIZE);
+    r->size = (size_t)end - CRYPT_HEADER_SIZE;
+
+    mbedtls_aes_init(&r->aes);
+    mbedtls_aes_setkey_enc(&r->aes, key, CRYPT_KEY_SIZE * 8);
+    return ESP_OK;
+}
+
+int crypt_reader_pread(crypt_reader_t *r, void *buf, size_t len, size_t offset)
+{
+    // Not clamped to r->size: the file may still be growing under a download
+    if (fseek(r->f, CRYPT_HEADER_SIZE + offset, SEEK_SET) != 0) {
+        return -1;
+    }
+    size_t n = fread(buf, 1, len, r->f);
+    if (n < len && ferror(r->f)) {
+        return -1;
+    }
+
+    uint8_t counter[16], stream[16];
+    size_t stream_off;
+    ctr_seek(&r->aes, r->nonce, offset, counter, stream, &stream_off);
+    mbedtls_aes_crypt_ctr(&r->aes, n, &stream_off, counter, stream, buf, buf);
+    return (int)n;
+}
+
+void crypt_reader_close(crypt_reader_t *r)
+{
+    if (r->f) {
+        fclose(r->f);
+        r->f = NULL;
+    }
+    mbedtls_aes_free(&r->aes);
+}
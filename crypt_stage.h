@@ -0,0 +1,64 @@
+#ifndef CRYPT_STAGE_H
+#define CRYPT_STAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "mbedtls/aes.h"
+#include "esp_err.h"
+#include "stage.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Encrypted files: a 16 byte header (magic + random nonce) followed by the
+// AES-256-CTR ciphertext. CTR keeps the file seekable: any byte can be
+// decrypted from its offset alone. There is no MAC; integrity comes from the
+// content digests (hash_sink, manifests), which are checked over the plaintext.
+#define CRYPT_KEY_SIZE       32
+#define CRYPT_NONCE_SIZE     12
+#define CRYPT_HEADER_SIZE    16
+#define CRYPT_BUDGET_PCT     10     // Warn when encryption takes more of the download than this
+
+typedef struct {
+    mbedtls_aes_context aes;
+    uint8_t key[CRYPT_KEY_SIZE];
+    uint8_t nonce[CRYPT_NONCE_SIZE];
+    uint8_t counter[16];
+    uint8_t stream[16];
+    size_t stream_off;
+    bool header_written;
+    uint64_t bytes;
+    uint64_t busy_us;           // Time spent in AES
+    int64_t first_push_us;
+} crypt_stage_ctx_t;
+
+// Stage that encrypts every span in place and passes it on to `next`
+void crypt_stage_init(stage_t *s, crypt_stage_ctx_t *ctx, const uint8_t key[CRYPT_KEY_SIZE], stage_t *next);
+
+// Per-device key kept in NVS (use NVS encryption to protect it at rest);
+// generated on first use
+esp_err_t crypt_get_device_key(uint8_t key[CRYPT_KEY_SIZE]);
+
+typedef struct {
+    FILE *f;
+    mbedtls_aes_context aes;
+    uint8_t nonce[CRYPT_NONCE_SIZE];
+    size_t size;                // Plaintext size when opened
+} crypt_reader_t;
+
+esp_err_t crypt_reader_open(crypt_reader_t *r, const char *path, const uint8_t key[CRYPT_KEY_SIZE]);
+
+// Decrypt up to len bytes at plaintext `offset`; returns bytes read (short at
+// the current end of file), -1 on error
+int crypt_reader_pread(crypt_reader_t *r, void *buf, size_t len, size_t offset);
+
+void crypt_reader_close(crypt_reader_t *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CRYPT_STAGE_H
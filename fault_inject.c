@@ -0,0 +1,189 @@
+#include "fault_inject.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "FAULT";
+
+#define FAULT_SCRIPT_MAX 512
+
+typedef struct {
+    fault_kind_t kind;
+    size_t at;              // Body offset, or attempt number for tls
+    uint32_t param;         // slow_write: delay in ms
+    bool fired;
+} fault_rule_t;
+
+static const char *const fault_names[] = {
+    [FAULT_SHORT_WRITE] = "short_write",
+    [FAULT_ENOSPC]      = "enospc",
+    [FAULT_SLOW_WRITE]  = "slow_write",
+    [FAULT_CONN_RESET]  = "reset",
+    [FAULT_TLS_ERROR]   = "tls",
+    [FAULT_TIMEOUT]     = "timeout",
+};
+
+static fault_rule_t rules[FAULT_MAX_RULES];
+static size_t rule_count = 0;
+static uint32_t fired_count = 0;
+static int64_t last_fired_us = 0;
+
+static esp_err_t parse_rule(const char *text, fault_rule_t *rule)
+{
+    char name[16];
+    unsigned long at = 0, param = 0;
+    int n = sscanf(text, " %15[a-z_]@%lu=%lu", name, &at, &param);
+    if (n < 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t k = 0; k < sizeof(fault_names) / sizeof(fault_names[0]); k++) {
+        if (strcmp(name, fault_names[k]) == 0) {
+            rule->kind = (fault_kind_t)k;
+            rule->at = at;
+            rule->param = param;
+            rule->fired = false;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t fault_inject_load(const char *script)
+{
+    char buf[FAULT_SCRIPT_MAX];
+    snprintf(buf, sizeof(buf), "%s", script);
+
+    fault_inject_clear();
+    char *save = NULL;
+    for (char *tok = strtok_r(buf, ";\n", &save); tok; tok = strtok_r(NULL, ";\n", &save)) {
+        tok += strspn(tok, " \t\r");
+        if (*tok == '\0' || *tok == '#') {
+            continue;
+        }
+        if (rule_count == FAULT_MAX_RULES) {
+            ESP_LOGE(TAG, "❌ More than %d rules", FAULT_MAX_RULES);
+            fault_inject_clear();   // A partial script must not stay armed
+            return ESP_ERR_NO_MEM;
+        }
+        if (parse_rule(tok, &rules[rule_count]) != ESP_OK) {
+            ESP_LOGE(TAG, "❌ Bad rule: %s", tok);
+            fault_inject_clear();
+            return ESP_ERR_INVALID_ARG;
+        }
+        rule_count++;
+    }
+    ESP_LOGW(TAG, "💥 Loaded %u fault rules", (unsigned)rule_count);
+    return ESP_OK;
+}
+
+esp_err_t fault_inject_load_file(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    char script[FAULT_SCRIPT_MAX];
+    size_t len = fread(script, 1, sizeof(script) - 1, f);
+    fclose(f);
+    script[len] = '\0';
+    return fault_inject_load(script);
+}
+
+void fault_inject_clear(void)
+{
+    rule_count = 0;
+    fired_count = 0;
+    last_fired_us = 0;
+}
+
+// First unfired rule of `kind` whose trigger lies in [from, to)
+static fault_rule_t *match(fault_kind_t kind, size_t from, size_t to)
+{
+    for (size_t i = 0; i < rule_count; i++) {
+        fault_rule_t *r = &rules[i];
+        if (r->kind == kind && !r->fired && r->at >= from && r->at < to) {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+static void fire(fault_rule_t *r)
+{
+    r->fired = true;
+    fired_count++;
+    last_fired_us = esp_timer_get_time();
+    ESP_LOGW(TAG, "💥 Injecting %s@%u", fault_names[r->kind], (unsigned)r->at);
+}
+
+esp_err_t fault_stage_push(stage_t *head, size_t offset, stage_span_t *span)
+{
+    // Rules are matched against the byte range this write covers
+    size_t len = span->len;
+    fault_rule_t *r = match(FAULT_ENOSPC, 0, offset + len);
+    if (r) {
+        fire(r);
+        stage_span_release(span);
+        return ESP_ERR_NO_MEM;
+    }
+    r = match(FAULT_SHORT_WRITE, 0, offset + len);
+    if (r) {
+        fire(r);
+        if (len > 1) {
+            stage_span_t half = { .data = span->data, .len = len / 2 };
+            stage_push(head, &half);
+        }
+        stage_span_release(span);
+        return ESP_FAIL;
+    }
+    for (size_t i = 0; i < rule_count; i++) {
+        if (rules[i].kind == FAULT_SLOW_WRITE && offset + len > rules[i].at) {
+            if (!rules[i].fired) {
+                fire(&rules[i]);
+            }
+            vTaskDelay(pdMS_TO_TICKS(rules[i].param));
+        }
+    }
+    return stage_push(head, span);
+}
+
+esp_err_t fault_net_receive(size_t offset, size_t len, uint32_t timeout_ms)
+{
+    fault_rule_t *r = match(FAULT_CONN_RESET, 0, offset + len);
+    if (r) {
+        fire(r);
+        return ESP_FAIL;
+    }
+    r = match(FAULT_TIMEOUT, 0, offset + len);
+    if (r) {
+        fire(r);
+        vTaskDelay(pdMS_TO_TICKS(timeout_ms));
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+esp_err_t fault_connect(int attempt)
+{
+    fault_rule_t *r = match(FAULT_TLS_ERROR, attempt, attempt + 1);
+    if (r) {
+        fire(r);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+uint32_t fault_inject_fired(void)
+{
+    return fired_count;
+}
+
+int64_t fault_inject_last_time_us(void)
+{
+    return last_fired_us;
+}
@@ -0,0 +1,48 @@
+#ifndef FAULT_INJECT_H
+#define FAULT_INJECT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "stage.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Build with -DFAULT_INJECT_ENABLED=1 to compile the hooks into the download path
+#ifndef FAULT_INJECT_ENABLED
+#define FAULT_INJECT_ENABLED 0
+#endif
+
+#define FAULT_MAX_RULES 16
+
+typedef enum {
+    FAULT_SHORT_WRITE,      // short_write@<offset>: write half the segment, then fail
+    FAULT_ENOSPC,           // enospc@<offset>: sink write fails with ESP_ERR_NO_MEM
+    FAULT_SLOW_WRITE,       // slow_write@<offset>=<ms>: every write from offset on sleeps ms
+    FAULT_CONN_RESET,       // reset@<offset>: connection drops when the body reaches offset
+    FAULT_TLS_ERROR,        // tls@<attempt>: that connection attempt fails before any byte
+    FAULT_TIMEOUT,          // timeout@<offset>: the read stalls for the HTTP timeout, then fails
+} fault_kind_t;
+
+// Script: rules separated by ';' or newlines, e.g. "reset@65536; enospc@200000".
+// Offsets are body byte positions. Every rule fires once, except slow_write.
+esp_err_t fault_inject_load(const char *script);
+esp_err_t fault_inject_load_file(const char *path);
+void fault_inject_clear(void);
+
+// Hooks called by the download path
+esp_err_t fault_stage_push(stage_t *head, size_t offset, stage_span_t *span);
+esp_err_t fault_net_receive(size_t offset, size_t len, uint32_t timeout_ms);
+esp_err_t fault_connect(int attempt);
+
+// Number of faults fired and esp_timer time of the last one (0 if none)
+uint32_t fault_inject_fired(void);
+int64_t fault_inject_last_time_us(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FAULT_INJECT_H
@@ -0,0 +1,233 @@
+#include "file_follow.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "https_client.h"
+
+static const char *TAG = "FILE_FOLLOW";
+
+// Append committed bytes to the ring; older bytes fall out to the flash path
+static void ram_append(file_follow_t *ff, const uint8_t *data, size_t len, size_t offset)
+{
+    if (offset != ff->ram_end) {
+        ff->ram_len = 0;        // Not contiguous with what we hold: start over
+    }
+    if (len > FILE_FOLLOW_RAM_BYTES) {
+        data += len - FILE_FOLLOW_RAM_BYTES;
+        offset += len - FILE_FOLLOW_RAM_BYTES;
+        len = FILE_FOLLOW_RAM_BYTES;
+    }
+    size_t at = offset % FILE_FOLLOW_RAM_BYTES;
+    size_t first = FILE_FOLLOW_RAM_BYTES - at < len ? FILE_FOLLOW_RAM_BYTES - at : len;
+    memcpy(ff->ram + at, data, first);
+    memcpy(ff->ram, data + first, len - first);
+
+    ff->ram_end = offset + len;
+    ff->ram_len = ff->ram_len + len < FILE_FOLLOW_RAM_BYTES ? ff->ram_len + len : FILE_FOLLOW_RAM_BYTES;
+}
+
+static void ram_copy(file_follow_t *ff, uint8_t *out, size_t len, size_t offset)
+{
+    size_t at = offset % FILE_FOLLOW_RAM_BYTES;
+    size_t first = FILE_FOLLOW_RAM_BYTES - at < len ? FILE_FOLLOW_RAM_BYTES - at : len;
+    memcpy(out, ff->ram + at, first);
+    memcpy(out + first, ff->ram, len - first);
+}
+
+static void on_file_event(void *ctx, https_file_event_t event, const uint8_t *data, size_t len, size_t offset)
+{
+    file_follow_t *ff = ctx;
+    xSemaphoreTake(ff->lock, portMAX_DELAY);
+    switch (event) {
+        case HTTPS_FILE_STARTED:
+            ff->restarted = ff->started;    // Bytes the consumer has may be stale now
+            ff->started = true;
+            ff->done = ff->failed = false;
+            ff->committed = 0;
+            ff->ram_end = ff->ram_len = 0;
+            break;
+
+        case HTTPS_FILE_DATA:
+            if (ff->ram) {
+                ram_append(ff, data, len, offset);
+            }
+            ff->committed = offset + len;
+            break;
+
+        case HTTPS_FILE_DONE:
+            ff->done = true;
+            break;
+
+        case HTTPS_FILE_FAILED:
+            ff->failed = true;
+            break;
+    }
+    xSemaphoreGive(ff->lock);
+    xSemaphoreGive(ff->progress);
+}
+
+esp_err_t file_follow_open(file_follow_t *ff, const char *path, const uint8_t *key)
+{
+    memset(ff, 0, sizeof(*ff));
+    ff->path = path;
+    ff->encrypted = key != NULL;
+    if (key) {
+        memcpy(ff->key, key, CRYPT_KEY_SIZE);
+    } else {
+        ff->ram = malloc(FILE_FOLLOW_RAM_BYTES);
+    }
+    ff->lock = xSemaphoreCreateMutex();
+    ff->progress = xSemaphoreCreateBinary();
+    if ((!ff->encrypted && ff->ram == NULL) || ff->lock == NULL || ff->progress == NULL) {
+        file_follow_close(ff);
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = https_watch_file(path, on_file_event, ff);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "❌ Can't watch %s (%s)", path, esp_err_to_name(err));
+        file_follow_close(ff);
+        return err;
+    }
+
+    // Joining a download already under way: what is on flash so far is readable
+    size_t committed;
+    uint32_t generation;
+    if (https_get_file_progress(path, &committed, &generation) == ESP_OK) {
+        xSemaphoreTake(ff->lock, portMAX_DELAY);
+        if (!ff->started) {
+            ff->started = true;
+            ff->committed = committed;
+            ff->ram_end = committed;
+        }
+        xSemaphoreGive(ff->lock);
+    }
+    return ESP_OK;
+}
+
+// Plaintext bytes committed so far
+static size_t readable_end(const file_follow_t *ff)
+{
+    if (!ff->encrypted) {
+        return ff->committed;
+    }
+    return ff->committed > CRYPT_HEADER_SIZE ? ff->committed - CRYPT_HEADER_SIZE : 0;
+}
+
+static esp_err_t flash_read(file_follow_t *ff, void *buf, size_t len, size_t *got)
+{
+    if (!ff->reader_open) {
+        esp_err_t err = file_reader_open(&ff->reader, ff->path, ff->encrypted ? ff->key : NULL);
+        if (err != ESP_OK) {
+            return err;
+        }
+        ff->reader_open = true;
+    }
+    int n = file_reader_pread(&ff->reader, buf, len, ff->pos);
+    if (n < 0) {
+        return ESP_FAIL;
+    }
+    *got = n;
+    return ESP_OK;
+}
+
+esp_err_t file_follow_read(file_follow_t *ff, void *buf, size_t len, size_t *got, uint32_t timeout_ms)
+{
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    *got = 0;
+
+    for (;;) {
+        xSemaphoreTake(ff->lock, portMAX_DELAY);
+        if (ff->restarted) {
+            ff->restarted = false;
+            if (ff->pos > 0) {
+                xSemaphoreGive(ff->lock);
+                ESP_LOGW(TAG, "⚠️ %s started over after %u bytes were read", ff->path, (unsigned)ff->pos);
+                return ESP_ERR_INVALID_STATE;
+            }
+        }
+        size_t end = readable_end(ff);
+        bool done = ff->done, failed = ff->failed;
+
+        if (ff->started && ff->pos < end) {
+            size_t n = end - ff->pos < len ? end - ff->pos : len;
+            if (ff->ram && ff->ram_len > 0 && ff->pos >= ff->ram_end - ff->ram_len) {
+                ram_copy(ff, buf, n, ff->pos);
+                xSemaphoreGive(ff->lock);
+                ff->ram_bytes += n;
+                ff->pos += n;
+                *got = n;
+                return ESP_OK;
+            }
+            xSemaphoreGive(ff->lock);
+
+            // Behind the RAM window: the bytes are on flash already
+            esp_err_t err = flash_read(ff, buf, n, got);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "❌ Flash read of %s at %u failed", ff->path, (unsigned)ff->pos);
+                return ESP_FAIL;
+            }
+            xSemaphoreTake(ff->lock, portMAX_DELAY);
+            bool restarted = ff->restarted;
+            xSemaphoreGive(ff->lock);
+            if (restarted) {
+                *got = 0;           // May hold bytes of the new file: report the restart instead
+                continue;
+            }
+            if (*got > 0) {
+                ff->flash_bytes += *got;
+                ff->pos += *got;
+                return ESP_OK;
+            }
+            // Nothing there after all (file restarted under us): wait for more
+        } else {
+            xSemaphoreGive(ff->lock);
+            if (failed) {
+                return ESP_FAIL;
+            }
+            if (done) {
+                return ESP_OK;              // End of file
+            }
+        }
+
+        int64_t left_us = deadline - esp_timer_get_time();
+        if (left_us <= 0) {
+            return ESP_ERR_TIMEOUT;
+        }
+        ff->waits++;
+        xSemaphoreTake(ff->progress, pdMS_TO_TICKS((left_us + 999) / 1000));
+    }
+}
+
+void file_follow_rewind(file_follow_t *ff)
+{
+    xSemaphoreTake(ff->lock, portMAX_DELAY);
+    ff->restarted = false;
+    ff->pos = 0;
+    xSemaphoreGive(ff->lock);
+}
+
+void file_follow_close(file_follow_t *ff)
+{
+    if (ff->lock && ff->progress) {
+        https_unwatch_file(on_file_event, ff);
+        ESP_LOGI(TAG, "📥 %s: %llu bytes from RAM, %llu from flash, %u waits",
+                 ff->path, ff->ram_bytes, ff->flash_bytes, (unsigned)ff->waits);
+    }
+    if (ff->reader_open) {
+        file_reader_close(&ff->reader);
+        ff->reader_open = false;
+    }
+    if (ff->lock) {
+        vSemaphoreDelete(ff->lock);
+        ff->lock = NULL;
+    }
+    if (ff->progress) {
+        vSemaphoreDelete(ff->progress);
+        ff->progress = NULL;
+    }
+    free(ff->ram);
+    ff->ram = NULL;
+    memset(ff->key, 0, sizeof(ff->key));
+}
@@ -0,0 +1,75 @@
+#ifndef FILE_FOLLOW_H
+#define FILE_FOLLOW_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "file_reader.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FILE_FOLLOW_RAM_BYTES   (16 * 1024)     // Newest committed bytes kept in RAM
+
+// Consume a file while https_download_file*() is still writing it. Reads block
+// until the bytes at the read position are committed, then come from a RAM
+// window of the newest bytes or, for a consumer that fell further behind, from
+// flash. If a retry starts the file over after the consumer has read some of
+// it, the next read returns ESP_ERR_INVALID_STATE; the consumer drops what it
+// has parsed and calls file_follow_rewind() to read the new file from 0.
+//
+// Open the follower before starting the download (or while it runs), from the
+// consumer task:
+//
+//     file_follow_open(&ff, path, NULL);
+//     while (file_follow_read(&ff, buf, sizeof(buf), &got, 30000) == ESP_OK && got > 0) {
+//         parse(buf, got);
+//     }
+//     file_follow_close(&ff);
+typedef struct {
+    const char *path;
+    bool encrypted;             // Encrypted files skip the RAM window (it holds ciphertext)
+    uint8_t key[CRYPT_KEY_SIZE];
+    file_reader_t reader;       // Flash path, opened on first use
+    bool reader_open;
+    SemaphoreHandle_t lock;     // Guards the state below against the watch callback
+    SemaphoreHandle_t progress; // Given on every download event
+    uint8_t *ram;               // Ring buffer, indexed by file offset
+    size_t ram_end;             // File offset just past the newest byte in ram
+    size_t ram_len;             // Valid bytes ending at ram_end
+    size_t committed;           // File bytes committed by the download
+    bool started;
+    bool done;
+    bool failed;
+    bool restarted;             // STARTED again since the consumer last looked
+    size_t pos;                 // Next byte the consumer reads
+    uint64_t ram_bytes;         // Consumer bytes served from RAM
+    uint64_t flash_bytes;       // ... and from flash
+    uint32_t waits;
+} file_follow_t;
+
+// key == NULL for plain files. path must stay valid until file_follow_close().
+esp_err_t file_follow_open(file_follow_t *ff, const char *path, const uint8_t *key);
+
+// Read up to len bytes at the current position, waiting up to timeout_ms for
+// them to be committed. ESP_OK with *got > 0: data; ESP_OK with *got == 0: the
+// download finished and everything was read; ESP_ERR_TIMEOUT: nothing new in
+// time; ESP_ERR_INVALID_STATE: the file started over under a consumer that had
+// already read part of it; ESP_FAIL: the download failed or the file couldn't
+// be read.
+esp_err_t file_follow_read(file_follow_t *ff, void *buf, size_t len, size_t *got, uint32_t timeout_ms);
+
+// Continue from offset 0 after file_follow_read() reported a restart
+void file_follow_rewind(file_follow_t *ff);
+
+void file_follow_close(file_follow_t *ff);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FILE_FOLLOW_H
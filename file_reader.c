@@ -0,0 +1,272 @@
+#include "file_reader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "esp_log.h"
+#include "https_client.h"
+#include "metrics.h"
+
+static const char *TAG = "FILE_READER";
+
+METRIC_DEFINE(m_cache_hits, "file_reader_cache_hits_total", METRIC_TYPE_COUNTER,
+              "Reads served from the reader block cache");
+METRIC_DEFINE(m_cache_misses, "file_reader_cache_misses_total", METRIC_TYPE_COUNTER,
+              "Reads that had to go to SPIFFS");
+
+static void drop_cache(file_reader_t *r)
+{
+    for (size_t i = 0; i < FILE_READER_BLOCKS; i++) {
+        r->blocks[i].offset = SIZE_MAX;
+        r->blocks[i].len = 0;
+    }
+    r->seq_reads = 0;
+}
+
+static esp_err_t open_backing(file_reader_t *r)
+{
+    if (r->encrypted) {
+        return crypt_reader_open(&r->crypt, r->path, r->key);
+    }
+    r->f = fopen(r->path, "rb");
+    if (r->f == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    setvbuf(r->f, NULL, _IONBF, 0);     // The block cache replaces stdio buffering
+    return ESP_OK;
+}
+
+static void close_backing(file_reader_t *r)
+{
+    if (r->encrypted) {
+        crypt_reader_close(&r->crypt);
+    } else if (r->f) {
+        fclose(r->f);
+        r->f = NULL;
+    }
+}
+
+static bool backing_is_open(file_reader_t *r)
+{
+    return (r->encrypted ? r->crypt.f : r->f) != NULL;
+}
+
+static int backing_read(file_reader_t *r, uint8_t *dst, size_t len, size_t offset)
+{
+    if (!backing_is_open(r)) {
+        return -1;              // Never opened, or a restart closed it
+    }
+    if (r->encrypted) {
+        return crypt_reader_pread(&r->crypt, dst, len, offset);
+    }
+    if (fseek(r->f, offset, SEEK_SET) != 0) {
+        return -1;
+    }
+    size_t n = fread(dst, 1, len, r->f);
+    return (n < len && ferror(r->f)) ? -1 : (int)n;
+}
+
+static size_t plaintext_size(file_reader_t *r, size_t file_size)
+{
+    if (!r->encrypted) {
+        return file_size;
+    }
+    return file_size > CRYPT_HEADER_SIZE ? file_size - CRYPT_HEADER_SIZE : 0;
+}
+
+// Bring r->size up to date with an in-progress download
+static void refresh_size(file_reader_t *r)
+{
+    if (!r->growing) {
+        return;
+    }
+    size_t committed;
+    uint32_t generation;
+    if (https_get_file_progress(r->path, &committed, &generation) == ESP_OK) {
+        if (generation != r->generation) {
+            // A retry started the file over (with a new nonce if encrypted)
+            drop_cache(r);
+            close_backing(r);
+            r->size = 0;
+            if ((r->encrypted && committed < CRYPT_HEADER_SIZE) || open_backing(r) != ESP_OK) {
+                return;                 // Try again on the next read
+            }
+            r->generation = generation;
+        }
+        r->size = plaintext_size(r, committed);
+        return;
+    }
+
+    // The download has finished (or given up) since the last look
+    r->growing = false;
+    drop_cache(r);
+    if (!backing_is_open(r) && open_backing(r) != ESP_OK) {
+        r->size = 0;            // A restart closed it and the file is gone or unreadable
+        return;
+    }
+    struct stat st;
+    r->size = stat(r->path, &st) == 0 ? plaintext_size(r, st.st_size) : 0;
+}
+
+static file_reader_block_t *find_block(file_reader_t *r, size_t base)
+{
+    for (size_t i = 0; i < FILE_READER_BLOCKS; i++) {
+        if (r->blocks[i].offset == base) {
+            return &r->blocks[i];
+        }
+    }
+    return NULL;
+}
+
+static file_reader_block_t *load_block(file_reader_t *r, file_reader_block_t *b, size_t base)
+{
+    if (b == NULL) {
+        b = &r->blocks[0];
+        for (size_t i = 1; i < FILE_READER_BLOCKS; i++) {
+            if (r->blocks[i].last_use < b->last_use) {
+                b = &r->blocks[i];
+            }
+        }
+    }
+    size_t want = r->size - base < FILE_READER_BLOCK_SIZE ? r->size - base : FILE_READER_BLOCK_SIZE;
+    int n = backing_read(r, b->data, want, base);
+    if (n < 0) {
+        b->offset = SIZE_MAX;
+        return NULL;
+    }
+    b->offset = base;
+    b->len = n;
+    b->last_use = ++r->clock;
+    return b;
+}
+
+int file_reader_pread(file_reader_t *r, void *buf, size_t len, size_t offset)
+{
+    refresh_size(r);
+    if (offset >= r->size) {
+        return 0;
+    }
+    if (len > r->size - offset) {
+        len = r->size - offset;
+    }
+
+    r->seq_reads = offset == r->next_seq ? r->seq_reads + 1 : 0;
+    uint8_t *out = buf;
+    size_t done = 0;
+    while (done < len) {
+        size_t pos = offset + done;
+        size_t base = pos - pos % FILE_READER_BLOCK_SIZE;
+        file_reader_block_t *b = find_block(r, base);
+        size_t need = r->size - base < FILE_READER_BLOCK_SIZE ? r->size - base : FILE_READER_BLOCK_SIZE;
+
+        if (b != NULL && b->len >= need) {
+            b->last_use = ++r->clock;
+            r->stats.hits++;
+            metric_counter_add(&m_cache_hits, 1);
+        } else {
+            // Missing, or the tail block of a file that has grown since
+            r->stats.misses++;
+            metric_counter_add(&m_cache_misses, 1);
+            b = load_block(r, b, base);
+            if (b == NULL) {
+                ESP_LOGE(TAG, "❌ Read failed at %u in %s", (unsigned)base, r->path);
+                return done > 0 ? (int)done : -1;
+            }
+            if (r->seq_reads >= FILE_READER_SEQ_READS) {
+                for (size_t i = 1; i <= FILE_READER_READAHEAD; i++) {
+                    size_t ahead = base + i * FILE_READER_BLOCK_SIZE;
+                    if (ahead >= r->size || find_block(r, ahead) != NULL) {
+                        break;
+                    }
+                    if (load_block(r, NULL, ahead) == NULL) {
+                        break;
+                    }
+                    r->stats.readahead_blocks++;
+                }
+            }
+        }
+
+        size_t in_block = pos - base;
+        if (in_block >= b->len) {
+            break;                              // File shorter than it claimed
+        }
+        size_t n = b->len - in_block < len - done ? b->len - in_block : len - done;
+        memcpy(out + done, b->data + in_block, n);
+        done += n;
+    }
+    r->next_seq = offset + done;
+    return (int)done;
+}
+
+int file_reader_read(file_reader_t *r, void *buf, size_t len)
+{
+    int n = file_reader_pread(r, buf, len, r->pos);
+    if (n > 0) {
+        r->pos += n;
+    }
+    return n;
+}
+
+void file_reader_seek(file_reader_t *r, size_t offset)
+{
+    r->pos = offset;
+}
+
+size_t file_reader_size(file_reader_t *r, bool *growing)
+{
+    refresh_size(r);
+    if (growing) {
+        *growing = r->growing;
+    }
+    return r->size;
+}
+
+esp_err_t file_reader_open(file_reader_t *r, const char *path, const uint8_t *key)
+{
+    memset(r, 0, sizeof(*r));
+    r->path = path;
+    r->encrypted = key != NULL;
+    if (key) {
+        memcpy(r->key, key, CRYPT_KEY_SIZE);
+    }
+    r->arena = malloc(FILE_READER_BLOCKS * FILE_READER_BLOCK_SIZE);
+    if (r->arena == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t i = 0; i < FILE_READER_BLOCKS; i++) {
+        r->blocks[i].data = r->arena + i * FILE_READER_BLOCK_SIZE;
+    }
+    drop_cache(r);
+
+    size_t committed = 0;
+    r->growing = https_get_file_progress(path, &committed, &r->generation) == ESP_OK;
+    esp_err_t err = ESP_OK;
+    if (r->growing && r->encrypted && committed < CRYPT_HEADER_SIZE) {
+        r->generation--;                // No header yet: refresh_size() opens it later
+    } else {
+        err = open_backing(r);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "❌ Failed to open %s (%s)", path, esp_err_to_name(err));
+        free(r->arena);
+        r->arena = NULL;
+        return err;
+    }
+
+    if (r->growing) {
+        refresh_size(r);
+    } else {
+        struct stat st;
+        r->size = stat(path, &st) == 0 ? plaintext_size(r, st.st_size) : 0;
+    }
+    return ESP_OK;
+}
+
+void file_reader_close(file_reader_t *r)
+{
+    ESP_LOGD(TAG, "📖 %s: %u hits, %u misses, %u blocks read ahead", r->path,
+             (unsigned)r->stats.hits, (unsigned)r->stats.misses, (unsigned)r->stats.readahead_blocks);
+    close_backing(r);
+    free(r->arena);
+    r->arena = NULL;
+    memset(r->key, 0, sizeof(r->key));
+}
@@ -0,0 +1,75 @@
+#ifndef FILE_READER_H
+#define FILE_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_err.h"
+#include "crypt_stage.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FILE_READER_BLOCK_SIZE   4096   // Cache block, one SPIFFS logical block
+#define FILE_READER_BLOCKS       8      // LRU cache size (32 KB per open reader)
+#define FILE_READER_SEQ_READS    2      // Back-to-back reads before read-ahead starts
+#define FILE_READER_READAHEAD    3      // Blocks prefetched past a sequential miss
+
+typedef struct {
+    size_t offset;              // Block-aligned file offset, SIZE_MAX when unused
+    size_t len;                 // Valid bytes, short for the last block of the file
+    uint32_t last_use;
+    uint8_t *data;
+} file_reader_block_t;
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t readahead_blocks;
+} file_reader_stats_t;
+
+// Random-access reader with a small LRU block cache for files on SPIFFS, plain
+// or written by crypt_stage. Works on a file that https_download_file*() is
+// still writing: reads only ever see committed bytes, and a retry that starts
+// the file over drops the cache. One reader per task.
+typedef struct {
+    const char *path;
+    FILE *f;                    // Plain files
+    bool encrypted;
+    crypt_reader_t crypt;       // Encrypted files
+    uint8_t key[CRYPT_KEY_SIZE];
+    uint8_t *arena;
+    file_reader_block_t blocks[FILE_READER_BLOCKS];
+    uint32_t clock;
+    size_t size;                // Readable bytes, refreshed while downloading
+    bool growing;               // A download is still writing the file
+    uint32_t generation;
+    size_t pos;                 // For file_reader_read()
+    size_t next_seq;            // Where a sequential read would continue
+    uint32_t seq_reads;
+    file_reader_stats_t stats;
+} file_reader_t;
+
+// key == NULL for plain files. path must stay valid until file_reader_close().
+esp_err_t file_reader_open(file_reader_t *r, const char *path, const uint8_t *key);
+
+// Read up to len bytes at offset; returns bytes read (0 at the end of what is
+// committed so far), -1 on error
+int file_reader_pread(file_reader_t *r, void *buf, size_t len, size_t offset);
+
+// Sequential read from the current position
+int file_reader_read(file_reader_t *r, void *buf, size_t len);
+void file_reader_seek(file_reader_t *r, size_t offset);
+
+// Bytes readable right now, and whether the file may still grow
+size_t file_reader_size(file_reader_t *r, bool *growing);
+
+void file_reader_close(file_reader_t *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FILE_READER_H
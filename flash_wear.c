@@ -0,0 +1,202 @@
+#include "flash_wear.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "spiffs.h"
+
+static const char *TAG = "FLASH_WEAR";
+
+#define BENCH_BIG_FILE_BYTES    (256 * 1024)
+#define BENCH_SMALL_FILES       32
+#define BENCH_SMALL_FILE_BYTES  4096
+#define BENCH_OVERWRITE_CYCLES  4
+#define BENCH_OVERWRITE_BYTES   (64 * 1024)
+#define BENCH_CHUNK             8192        // Same as the download write segments
+
+static portMUX_TYPE wear_lock = portMUX_INITIALIZER_UNLOCKED;
+static flash_wear_stats_t wear;
+static uint16_t *sector_erases = NULL;      // Per sector of the SPIFFS partition
+static size_t sector_count = 0;
+
+// Provided by the linker for -Wl,--wrap=... (see CMakeLists.txt)
+esp_err_t __real_esp_partition_write(const esp_partition_t *part, size_t dst_offset,
+                                     const void *src, size_t size);
+esp_err_t __real_esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size);
+
+static bool is_spiffs(const esp_partition_t *part)
+{
+    return part->type == ESP_PARTITION_TYPE_DATA &&
+           strcmp(part->label, SPIFFS_PARTITION_LABEL) == 0;
+}
+
+esp_err_t __wrap_esp_partition_write(const esp_partition_t *part, size_t dst_offset,
+                                     const void *src, size_t size)
+{
+    if (!is_spiffs(part) || size == 0) {
+        return __real_esp_partition_write(part, dst_offset, src, size);
+    }
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t ret = __real_esp_partition_write(part, dst_offset, src, size);
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+
+    uint32_t pages = (dst_offset + size - 1) / FLASH_PAGE_SIZE - dst_offset / FLASH_PAGE_SIZE + 1;
+    portENTER_CRITICAL(&wear_lock);
+    wear.program_calls++;
+    wear.program_bytes += size;
+    wear.pages_programmed += pages;
+    wear.program_us += us;
+    portEXIT_CRITICAL(&wear_lock);
+    return ret;
+}
+
+esp_err_t __wrap_esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size)
+{
+    if (!is_spiffs(part) || size == 0) {
+        return __real_esp_partition_erase_range(part, offset, size);
+    }
+    if (sector_erases == NULL) {
+        // Erases come from the one task holding the SPIFFS lock, so no race here
+        sector_count = part->size / FLASH_SECTOR_SIZE;
+        sector_erases = calloc(sector_count, sizeof(uint16_t));
+    }
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t ret = __real_esp_partition_erase_range(part, offset, size);
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+
+    size_t first = offset / FLASH_SECTOR_SIZE;
+    size_t count = size / FLASH_SECTOR_SIZE;
+    portENTER_CRITICAL(&wear_lock);
+    wear.erase_calls++;
+    wear.sectors_erased += count;
+    wear.erase_us += us;
+    for (size_t s = first; sector_erases && s < first + count && s < sector_count; s++) {
+        if (sector_erases[s] < UINT16_MAX) {
+            sector_erases[s]++;
+        }
+    }
+    portEXIT_CRITICAL(&wear_lock);
+    return ret;
+}
+
+void flash_wear_get(flash_wear_stats_t *stats)
+{
+    portENTER_CRITICAL(&wear_lock);
+    *stats = wear;
+    stats->max_sector_erases = 0;
+    stats->min_sector_erases = sector_count ? UINT16_MAX : 0;
+    for (size_t s = 0; sector_erases && s < sector_count; s++) {
+        if (sector_erases[s] > stats->max_sector_erases) {
+            stats->max_sector_erases = sector_erases[s];
+        }
+        if (sector_erases[s] < stats->min_sector_erases) {
+            stats->min_sector_erases = sector_erases[s];
+        }
+    }
+    portEXIT_CRITICAL(&wear_lock);
+}
+
+void flash_wear_diff(const flash_wear_stats_t *a, const flash_wear_stats_t *b, flash_wear_stats_t *out)
+{
+    out->program_calls = b->program_calls - a->program_calls;
+    out->program_bytes = b->program_bytes - a->program_bytes;
+    out->pages_programmed = b->pages_programmed - a->pages_programmed;
+    out->erase_calls = b->erase_calls - a->erase_calls;
+    out->sectors_erased = b->sectors_erased - a->sectors_erased;
+    out->program_us = b->program_us - a->program_us;
+    out->erase_us = b->erase_us - a->erase_us;
+    out->max_sector_erases = b->max_sector_erases;
+    out->min_sector_erases = b->min_sector_erases;
+}
+
+void flash_wear_report(const char *workload, const flash_wear_stats_t *d, size_t logical_bytes)
+{
+    // Write amplification: bytes of pages programmed per byte the application wrote
+    double wa = logical_bytes ? (double)d->pages_programmed * FLASH_PAGE_SIZE / logical_bytes : 0;
+    double erases_per_mb = logical_bytes ? d->sectors_erased * 1048576.0 / logical_bytes : 0;
+    ESP_LOGI(TAG, "🔩 %s: %u bytes -> %u page programs (%u calls, %llu ms), "
+             "%u sector erases (%llu ms)",
+             workload, (unsigned)logical_bytes, (unsigned)d->pages_programmed,
+             (unsigned)d->program_calls, d->program_us / 1000,
+             (unsigned)d->sectors_erased, d->erase_us / 1000);
+    ESP_LOGI(TAG, "🔩 %s: write amplification %.2f, %.1f erases/MB, sector erases min %u max %u",
+             workload, wa, erases_per_mb,
+             (unsigned)d->min_sector_erases, (unsigned)d->max_sector_erases);
+}
+
+static size_t write_file(const char *path, const uint8_t *chunk, size_t bytes)
+{
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        return 0;
+    }
+    size_t written = 0;
+    while (written < bytes) {
+        size_t len = bytes - written < BENCH_CHUNK ? bytes - written : BENCH_CHUNK;
+        if (fwrite(chunk, 1, len, f) != len) {
+            break;
+        }
+        written += len;
+    }
+    fclose(f);
+    return written;
+}
+
+esp_err_t flash_wear_benchmark(const char *dir)
+{
+    uint8_t *chunk = malloc(BENCH_CHUNK);
+    if (chunk == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t i = 0; i < BENCH_CHUNK; i++) {
+        chunk[i] = (uint8_t)(i * 31 + 7);
+    }
+
+    char path[64];
+    flash_wear_stats_t before, after, delta;
+    size_t logical;
+
+    // 1. One big file, streamed like a download
+    snprintf(path, sizeof(path), "%s/wear_big.bin", dir);
+    flash_wear_get(&before);
+    logical = write_file(path, chunk, BENCH_BIG_FILE_BYTES);
+    flash_wear_get(&after);
+    flash_wear_diff(&before, &after, &delta);
+    flash_wear_report("big file", &delta, logical);
+    unlink(path);
+
+    // 2. Many small files (per-file metadata dominates)
+    flash_wear_get(&before);
+    logical = 0;
+    for (int i = 0; i < BENCH_SMALL_FILES; i++) {
+        snprintf(path, sizeof(path), "%s/wear_s%02d.bin", dir, i);
+        logical += write_file(path, chunk, BENCH_SMALL_FILE_BYTES);
+    }
+    flash_wear_get(&after);
+    flash_wear_diff(&before, &after, &delta);
+    flash_wear_report("small files", &delta, logical);
+    for (int i = 0; i < BENCH_SMALL_FILES; i++) {
+        snprintf(path, sizeof(path), "%s/wear_s%02d.bin", dir, i);
+        unlink(path);
+    }
+
+    // 3. Rewriting the same file (deleted pages must be reclaimed by GC)
+    snprintf(path, sizeof(path), "%s/wear_ow.bin", dir);
+    flash_wear_get(&before);
+    logical = 0;
+    for (int i = 0; i < BENCH_OVERWRITE_CYCLES; i++) {
+        logical += write_file(path, chunk, BENCH_OVERWRITE_BYTES);
+    }
+    flash_wear_get(&after);
+    flash_wear_diff(&before, &after, &delta);
+    flash_wear_report("overwrite cycles", &delta, logical);
+    unlink(path);
+
+    free(chunk);
+    return ESP_OK;
+}
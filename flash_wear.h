@@ -0,0 +1,46 @@
+#ifndef FLASH_WEAR_H
+#define FLASH_WEAR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// NOR geometry of the SPI flash behind the SPIFFS partition
+#define FLASH_PAGE_SIZE    256      // Program granularity
+#define FLASH_SECTOR_SIZE  4096     // Erase granularity
+
+// Physical operations SPIFFS issued on its partition. Counted by wrapping
+// esp_partition_write/erase_range at link time, so these are real, not modelled.
+typedef struct {
+    uint32_t program_calls;
+    uint64_t program_bytes;
+    uint32_t pages_programmed;      // 256 B pages touched by programs
+    uint32_t erase_calls;
+    uint32_t sectors_erased;
+    uint64_t program_us;
+    uint64_t erase_us;
+    uint16_t max_sector_erases;     // Most-erased sector since boot (wear leveling evenness)
+    uint16_t min_sector_erases;
+} flash_wear_stats_t;
+
+void flash_wear_get(flash_wear_stats_t *stats);
+
+// b - a for the counters; max/min are taken from b
+void flash_wear_diff(const flash_wear_stats_t *a, const flash_wear_stats_t *b, flash_wear_stats_t *out);
+
+// Log a workload's cost per logical byte written
+void flash_wear_report(const char *workload, const flash_wear_stats_t *delta, size_t logical_bytes);
+
+// Run the reference workloads (one big file, many small files, overwrite
+// cycles) in `dir` and report each; the files are removed afterwards
+esp_err_t flash_wear_benchmark(const char *dir);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLASH_WEAR_H
@@ -0,0 +1,74 @@
+#include "hash_sink.h"
+#include <string.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "spiffs.h"
+
+static const char *TAG = "HASH_SINK";
+
+static esp_err_t hash_sink_write(void *ctx, const uint8_t *data, size_t len)
+{
+    hash_sink_ctx_t *hs = ctx;
+    mbedtls_sha256_update(&hs->sha, data, len);
+    if (fwrite(data, 1, len, hs->f) != len) {
+        return ESP_FAIL;
+    }
+    hs->bytes += len;
+    return ESP_OK;
+}
+
+static esp_err_t hash_sink_reset(void *ctx)
+{
+    hash_sink_ctx_t *hs = ctx;
+    mbedtls_sha256_starts(&hs->sha, 0);
+    hs->bytes = 0;
+    hs->f = freopen(hs->path, "wb", hs->f);
+    return hs->f ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t hash_sink_reserve(void *ctx, size_t bytes)
+{
+    return spiffs_reserve(bytes);
+}
+
+static esp_err_t hash_sink_finish(void *ctx)
+{
+    hash_sink_ctx_t *hs = ctx;
+    mbedtls_sha256_finish(&hs->sha, hs->digest);
+    mbedtls_sha256_free(&hs->sha);
+    int err = fclose(hs->f);
+    hs->f = NULL;
+    return err == 0 ? ESP_OK : ESP_FAIL;
+}
+
+static void hash_sink_abort(void *ctx)
+{
+    hash_sink_ctx_t *hs = ctx;
+    mbedtls_sha256_free(&hs->sha);
+    if (hs->f) {
+        fclose(hs->f);
+        hs->f = NULL;
+    }
+    unlink(hs->path);
+}
+
+esp_err_t hash_sink_init(download_sink_t *sink, hash_sink_ctx_t *ctx, const char *path)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->path = path;
+    ctx->f = fopen(path, "wb");
+    if (!ctx->f) {
+        ESP_LOGE(TAG, "❌ Failed to open %s", path);
+        return ESP_FAIL;
+    }
+    mbedtls_sha256_init(&ctx->sha);
+    mbedtls_sha256_starts(&ctx->sha, 0);
+
+    sink->write = hash_sink_write;
+    sink->reset = hash_sink_reset;
+    sink->reserve = hash_sink_reserve;
+    sink->finish = hash_sink_finish;
+    sink->abort = hash_sink_abort;
+    sink->ctx = ctx;
+    return ESP_OK;
+}
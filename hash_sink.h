@@ -0,0 +1,34 @@
+#ifndef HASH_SINK_H
+#define HASH_SINK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "mbedtls/sha256.h"
+#include "https_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HASH_SINK_DIGEST_LEN 32   // SHA-256
+
+// File sink that computes SHA-256 of the content as it streams in.
+// After a successful finish, `digest` and `bytes` describe the file;
+// abort deletes the partial file.
+typedef struct {
+    FILE *f;
+    const char *path;
+    mbedtls_sha256_context sha;
+    uint8_t digest[HASH_SINK_DIGEST_LEN];
+    size_t bytes;
+} hash_sink_ctx_t;
+
+// `ctx` must outlive the download; `path` is truncated/created here
+esp_err_t hash_sink_init(download_sink_t *sink, hash_sink_ctx_t *ctx, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HASH_SINK_H
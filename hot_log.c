@@ -0,0 +1,23 @@
+#include "hot_log.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+static portMUX_TYPE ratelimit_lock = portMUX_INITIALIZER_UNLOCKED;
+
+bool log_ratelimit_allow(log_ratelimit_t *rl, uint32_t interval_ms, uint32_t *suppressed)
+{
+    int64_t now = esp_timer_get_time();
+    bool allow = false;
+
+    portENTER_CRITICAL(&ratelimit_lock);
+    if (now >= rl->next_us) {
+        rl->next_us = now + (int64_t)interval_ms * 1000;
+        *suppressed = rl->suppressed;
+        rl->suppressed = 0;
+        allow = true;
+    } else {
+        rl->suppressed++;
+    }
+    portEXIT_CRITICAL(&ratelimit_lock);
+    return allow;
+}
@@ -0,0 +1,62 @@
+#ifndef HOT_LOG_H
+#define HOT_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Level for logs on the data path (per header, per HTTP event). Anything more
+// verbose is compiled out, format strings included, so a chatty UART at
+// 115200 baud can't throttle the download task. Override per build with
+// -DHOT_LOG_LEVEL=ESP_LOG_INFO when debugging a server.
+#ifndef HOT_LOG_LEVEL
+#define HOT_LOG_LEVEL ESP_LOG_WARN
+#endif
+
+#define HOT_LOG(level, tag, fmt, ...) do {                                  \
+        if (HOT_LOG_LEVEL >= (level)) {                                     \
+            ESP_LOG_LEVEL_LOCAL((level), (tag), fmt, ##__VA_ARGS__);        \
+        }                                                                   \
+    } while (0)
+
+#define HOT_LOGW(tag, fmt, ...) HOT_LOG(ESP_LOG_WARN, tag, fmt, ##__VA_ARGS__)
+#define HOT_LOGI(tag, fmt, ...) HOT_LOG(ESP_LOG_INFO, tag, fmt, ##__VA_ARGS__)
+#define HOT_LOGD(tag, fmt, ...) HOT_LOG(ESP_LOG_DEBUG, tag, fmt, ##__VA_ARGS__)
+
+typedef struct {
+    int64_t next_us;            // Earliest time the next message may go out
+    uint32_t suppressed;        // Messages dropped since the last one printed
+} log_ratelimit_t;
+
+// True if a message may be printed now; *suppressed gets the number dropped since
+bool log_ratelimit_allow(log_ratelimit_t *rl, uint32_t interval_ms, uint32_t *suppressed);
+
+// Recurring warnings (slow link, disconnects): at most one per interval_ms per
+// call site, with a count of what was dropped in between
+#define LOG_RATELIMIT(level, interval_ms, tag, fmt, ...) do {               \
+        static log_ratelimit_t _rl;                                         \
+        uint32_t _suppressed;                                               \
+        if (log_ratelimit_allow(&_rl, (interval_ms), &_suppressed)) {       \
+            if (_suppressed) {                                              \
+                ESP_LOG_LEVEL_LOCAL((level), (tag), fmt " (%u suppressed)", \
+                                    ##__VA_ARGS__, (unsigned)_suppressed);  \
+            } else {                                                        \
+                ESP_LOG_LEVEL_LOCAL((level), (tag), fmt, ##__VA_ARGS__);    \
+            }                                                               \
+        }                                                                   \
+    } while (0)
+
+#define LOG_RATELIMIT_W(interval_ms, tag, fmt, ...) \
+    LOG_RATELIMIT(ESP_LOG_WARN, interval_ms, tag, fmt, ##__VA_ARGS__)
+#define LOG_RATELIMIT_E(interval_ms, tag, fmt, ...) \
+    LOG_RATELIMIT(ESP_LOG_ERROR, interval_ms, tag, fmt, ##__VA_ARGS__)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOT_LOG_H
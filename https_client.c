@@ -1,109 +1,754 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>            // ✅ For strcasecmp
 #include <errno.h>              // ✅ For errno + strerror
 #include <unistd.h>             // ✅ For unlink()
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "esp_err.h"
 #include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_heap_caps.h"
+#include "nvs.h"
 
 #include "esp_http_client.h"     // ✅ For esp_http_client_* types & funcs
 #include "esp_crt_bundle.h"      // ✅ For esp_crt_bundle_attach
 #include "esp_spiffs.h"          // ✅ For esp_spiffs_info
+#include "spiffs.h"              // ✅ For spiffs_reserve
+#include "wifi.h"                // ✅ For wifi_wait_ready
+#include "buf_pool.h"
+#include "rate_limit.h"
+#include "stage.h"
+#include "metrics.h"
+#include "hot_log.h"
+#include "trace.h"
+#include "fault_inject.h"
+#include "flash_wear.h"
+#include "crypt_stage.h"
+#include "https_client.h"
 
 static const char *TAG = "https_client";
 
-#define MAX_RETRIES          3
+#define DOWNLOAD_DEADLINE_MS 120000         // Give up after 2 min in total, not after N attempts
 #define MIN_SPEED_BPS        (400 * 1024)   // 400 KBps
 #define HTTP_TIMEOUT_MS      5000           // 5 sec read timeout
-#define BACKOFF_BASE_MS      1000           // 1 sec base backoff
-#define WRITE_BUFFER_SIZE    32768           // 🚀 8 KB RAM buffer
+#define BACKOFF_BASE_MS      500            // 0.5 sec base backoff
+#define BACKOFF_MAX_MS       8000           // Backoff ceiling before jitter
+#define WRITE_SEGMENT_SIZE   8192            // 🚀 Write buffer grows/shrinks in 8 KB segments
+#define WRITE_BUFFER_MIN     8192
+#define WRITE_BUFFER_INITIAL 32768
+#define WRITE_BUFFER_MAX     65536
+#define WRITE_SEGMENTS_MAX   (WRITE_BUFFER_MAX / WRITE_SEGMENT_SIZE)
+#define WRITE_BUFFER_HEADROOM 2              // Size for 2x the bytes arriving during a flush
+#define FLUSH_LAT_DECAY_SHIFT 3              // Slowest recent flush decays by 1/8 per flush
+#define HTTP_RX_BUFFER_SIZE  32768           // Client RX buffer, event (perform) mode
+#define PULL_RX_BUFFER_SIZE  4096            // Client RX buffer, pull mode
+#define HTTPS_PULL_MODE_DEFAULT true
+#define DOWNLOAD_POOL_BUFFERS_PSRAM (2 * WRITE_SEGMENTS_MAX)  // Full write buffer plus a full pipeline queue
+#define DOWNLOAD_POOL_BUFFERS_DIRECT WRITE_SEGMENTS_MAX      // Full write buffer, no pipeline
+#define DOWNLOAD_POOL_BUFFERS_INTERNAL 4     // 32 KB when there is no PSRAM
+#define DOWNLOAD_POOL_HEAP_RESERVE (64 * 1024)  // Internal heap left for Wi-Fi, lwIP and TLS
+#define DOWNLOAD_POOL_WAIT_MS 10000
+#define MAX_REDIRECTS        5
+#define RATE_LIMIT_BURST     16384           // Token bucket depth for both limiters
+#define RESERVE_STEP_BYTES   65536           // Unknown-length bodies reserve space in 64 KB steps
+#define PIPELINE_NET_STACK    8192            // esp_http_client + TLS handshake
+#define PIPELINE_WRITER_STACK 6144            // Sinks: SHA-256, inflate, VFS writes
+#define PIPELINE_QUEUE_LEN    WRITE_SEGMENTS_MAX  // In-flight segments; pool holds the rest
+#define WARN_INTERVAL_MS     10000           // Recurring warnings at most once per 10 sec
+#define VALIDATOR_MAX        96              // ETag / Last-Modified sent back as If-Range
+#define FILE_SYNC_INTERVAL   (256 * 1024)    // Unfollowed files: fsync at most once per 256 KB
 
-static FILE *file_handle = NULL;
-static size_t total_bytes = 0;
+// 🚀 Live throughput monitor: drop a trickling connection instead of waiting it out
+#define RATE_BUCKET_MS       500            // Sliding window granularity
+#define RATE_WINDOW_BUCKETS  8              // 8 x 0.5 sec = 4 sec window
+#define RATE_GRACE_MS        3000           // Let TCP ramp up before judging
+#define SLOW_ABORT_BPS       (MIN_SPEED_BPS / 2)
+#define SLOW_ABORT_MAX       3              // Consecutive slow aborts before accepting the link
+
+// 🚀 Mirror selection: rank by remembered throughput, probe the unknown ones
+#define MAX_MIRRORS          8
+#define MIRROR_NVS_NAMESPACE "mirror_score" // {bps, seq} blobs; the old u32 scores stay unused
+#define MIRROR_PROBE_BYTES   16384          // Probe reads at most this much, Range honoured or not
+#define MIRROR_MIN_SAMPLE    65536          // Ignore attempts too short to say anything
+#define MIRROR_EWMA_SHIFT    2              // New sample weighs 1/4
+#define MIRROR_MAX_AGE       16             // Downloads a score stays valid without a new sample
+#define MIRROR_SEQ_KEY       "seq"          // Download counter that scores are aged against
+#define MIRROR_SEQ_STEP      8              // Counter is persisted as a ceiling, once per 8 downloads
+#define MIRROR_SAVE_SHIFT    3              // Re-save a score once it moved by 1/8 (or half aged)
+
+typedef struct {
+    uint32_t bps;                           // 1 = probe failed, rank last
+    uint32_t seq;                           // mirror_seq when last measured
+} mirror_score_t;
+
+typedef struct {
+    const char *url;
+    uint32_t bps;                           // Smoothed throughput, 0 = unknown
+    mirror_score_t saved;                   // What NVS holds, to skip redundant writes
+    bool dead;                              // Answered with a permanent HTTP error
+} mirror_t;
+
+typedef struct {
+    uint32_t bytes[RATE_WINDOW_BUCKETS];
+    int64_t start_us;
+    int64_t newest;                         // Index of the newest bucket since start_us
+} rate_monitor_t;
+
+static stage_t *chain = NULL;             // Stage chain committed bytes go through
+static stage_t flash_rate_stage;          // Head of the chain: the flash write throttle
+static volatile size_t total_bytes = 0;   // Bytes committed to the file (resume offset)
+static size_t resume_offset = 0;          // Offset requested via Range for this attempt
+static bool response_checked = false;
+static bool space_reserved = false;       // Sink reserved the rest of this response
+static size_t reserved_until = 0;         // Unknown length: attempt bytes covered by reservations
+static bool body_has_length = false;      // Response carried a Content-Length header
+static bool body_chunked = false;
+static bool body_eof = false;             // Pull mode saw the server close the connection
+static int64_t range_start = -1;          // First byte per Content-Range, -1 if absent
+static int64_t range_total = -1;          // Complete length per Content-Range, -1 if unknown
+static char response_validator[VALIDATOR_MAX];  // ETag (strong) or Last-Modified of this response
+static char resume_validator[VALIDATOR_MAX];    // ... of the response our committed bytes came from
+static bool range_complete = false;       // 416: nothing past resume_offset, we already have it all
+static size_t max_body_bytes = 0;         // 0 = no cap
+static bool size_exceeded = false;
+static bool http_error = false;
+static int http_status = 0;
 static int64_t start_time = 0;
-static bool storage_error = false;
+static volatile bool storage_error = false;  // Also set by the pipeline writer
+static int64_t first_byte_time = 0;       // us since boot, 0 until first payload byte
+static rate_monitor_t rate;
+static bool rate_monitor_enabled = true;
+static bool slow_abort = false;
+static bool pull_mode = HTTPS_PULL_MODE_DEFAULT;
+
+// Background-download throttles (0 = unlimited), adjustable mid-transfer
+static rate_limiter_t net_limiter;
+static rate_limiter_t flash_limiter;
+static bool limiters_ready = false;
 
-// 🚀 RAM buffer for fewer SPIFFS writes
-static uint8_t write_buffer[WRITE_BUFFER_SIZE];
+// 🚀 Session: consecutive downloads share one keep-alive client/connection
+static bool session_active = false;
+static esp_http_client_handle_t session_client = NULL;
+
+// 🚀 RAM buffer for fewer SPIFFS writes, built from segments borrowed from the
+// download pool (PSRAM when present) so internal RAM stays free for Wi-Fi/lwIP.
+// Its size follows the measured flush latency and network rate.
+static buf_pool_t *download_pool = NULL;       // Kept for the process, see download_pool_get()
+static size_t download_pool_buffers = 0;
+static bool download_pool_pipelined = false;    // Pipeline setting the pool was sized for
+static uint8_t *write_segments[WRITE_SEGMENTS_MAX];
+static size_t segment_count = 0;
 static size_t buffer_offset = 0;
+static size_t attempt_received = 0;       // Network bytes received this attempt
+static uint32_t flush_lat_us = 0;         // Decaying max of recent flush latency
+static uint64_t flush_total_us = 0;
+static https_download_stats_t stats;
+
+// 🚀 Pipeline: full segments go to a writer task on the other core
+typedef struct {
+    uint8_t *seg;           // NULL = marker: signal writer_idle (len = 1: then exit)
+    size_t len;
+} write_job_t;
+
+static https_pipeline_config_t pipeline = {
+    .enabled = true,
+    .net_core = 0,
+    .net_priority = 5,
+    .writer_core = portNUM_PROCESSORS > 1 ? 1 : 0,
+    .writer_priority = 5,
+};
+static bool pipeline_active = false;
+static QueueHandle_t writer_queue = NULL;
+static SemaphoreHandle_t writer_idle = NULL;
+static uint64_t writer_busy_us = 0;
+static uint64_t net_stall_us = 0;
+
+#if FAULT_INJECT_ENABLED
+#define STAGE_PUSH(offset, span) fault_stage_push(chain, (offset), (span))
+#else
+#define STAGE_PUSH(offset, span) stage_push(chain, (span))
+#endif
+
+METRIC_DEFINE(m_net_bytes, "download_net_bytes_total", METRIC_TYPE_COUNTER,
+              "Body bytes received from the network");
+METRIC_DEFINE(m_flash_bytes, "download_flash_bytes_total", METRIC_TYPE_COUNTER,
+              "Bytes committed to the stage chain");
+METRIC_DEFINE(m_flush_us, "download_flush_latency_us", METRIC_TYPE_HISTOGRAM,
+              "Time to push the buffer through the stage chain");
+METRIC_DEFINE(m_buffer_bytes, "download_write_buffer_bytes", METRIC_TYPE_GAUGE,
+              "Current write buffer size");
+METRIC_DEFINE(m_net_rate, "download_net_rate_bps", METRIC_TYPE_GAUGE,
+              "Receive rate of the current attempt");
+METRIC_DEFINE(m_attempts, "download_attempts_total", METRIC_TYPE_COUNTER,
+              "Connection attempts, including retries and failovers");
+METRIC_DEFINE(m_failed_attempts, "download_failed_attempts_total", METRIC_TYPE_COUNTER,
+              "Attempts that did not complete the body");
+METRIC_DEFINE(m_slow_aborts, "download_slow_aborts_total", METRIC_TYPE_COUNTER,
+              "Connections dropped for being too slow");
+METRIC_DEFINE(m_downloads, "download_completed_total", METRIC_TYPE_COUNTER,
+              "Downloads finished successfully");
+METRIC_DEFINE(m_first_byte_us, "download_first_byte_latency_us", METRIC_TYPE_HISTOGRAM,
+              "Attempt start to first body byte");
+
+static void init_limiters(void)
+{
+    if (!limiters_ready) {
+        rate_limiter_init(&net_limiter, 0, RATE_LIMIT_BURST);
+        rate_limiter_init(&flash_limiter, 0, RATE_LIMIT_BURST);
+        limiters_ready = true;
+    }
+}
+
+static size_t buffer_capacity(void)
+{
+    return segment_count * WRITE_SEGMENT_SIZE;
+}
+
+// Where the next byte goes, and how many fit there contiguously
+static uint8_t *buffer_tail(size_t *contiguous)
+{
+    size_t in_segment = buffer_offset % WRITE_SEGMENT_SIZE;
+    *contiguous = WRITE_SEGMENT_SIZE - in_segment;
+    return write_segments[buffer_offset / WRITE_SEGMENT_SIZE] + in_segment;
+}
+
+// Grow or shrink the (empty) buffer towards what the measured rates call for
+static void adapt_write_buffer(void)
+{
+    int64_t elapsed_us = esp_timer_get_time() - start_time;
+    if (elapsed_us <= 0 || flush_lat_us == 0) {
+        return;
+    }
+    uint64_t rate_bps = (uint64_t)attempt_received * 1000000 / elapsed_us;
+    uint64_t target = rate_bps * flush_lat_us / 1000000 * WRITE_BUFFER_HEADROOM;
+    if (target < WRITE_BUFFER_MIN) {
+        target = WRITE_BUFFER_MIN;
+    } else if (target > WRITE_BUFFER_MAX) {
+        target = WRITE_BUFFER_MAX;
+    }
+    size_t target_segments = (target + WRITE_SEGMENT_SIZE - 1) / WRITE_SEGMENT_SIZE;
+    stats.net_rate_bps = (uint32_t)rate_bps;
+    metric_gauge_set(&m_net_rate, (int32_t)rate_bps);
+
+    if (target_segments > segment_count) {
+        // Never block the data path waiting for memory; stay smaller instead
+        size_t before = segment_count;
+        while (segment_count < target_segments) {
+            uint8_t *seg = buf_pool_acquire(download_pool, 0);
+            if (seg == NULL) {
+                break;
+            }
+            write_segments[segment_count++] = seg;
+        }
+        if (segment_count > before) {
+            stats.write_buffer_grows++;
+        }
+    } else if (target_segments + 1 < segment_count) {
+        // One segment of hysteresis so we don't flap around the boundary
+        while (segment_count > target_segments) {
+            buf_pool_release(download_pool, write_segments[--segment_count]);
+        }
+        stats.write_buffer_shrinks++;
+    }
+
+    stats.write_buffer_size = buffer_capacity();
+    metric_gauge_set(&m_buffer_bytes, (int32_t)stats.write_buffer_size);
+    if (stats.write_buffer_size > stats.write_buffer_peak) {
+        stats.write_buffer_peak = stats.write_buffer_size;
+    }
+}
+
+// Latency of one flush (or, pipelined, one segment write) feeds the buffer sizing
+static void record_flush(uint32_t lat)
+{
+    flush_lat_us -= flush_lat_us >> FLUSH_LAT_DECAY_SHIFT;
+    if (lat > flush_lat_us) {
+        flush_lat_us = lat;
+    }
+    if (lat > stats.flush_max_us) {
+        stats.flush_max_us = lat;
+    }
+    flush_total_us += lat;
+    stats.flush_count++;
+    metric_histogram_observe(&m_flush_us, lat);
+}
+
+static void release_segment(void *owner, uint8_t *buf)
+{
+    buf_pool_release(owner, buf);
+}
+
+static void writer_task(void *arg)
+{
+    write_job_t job;
+    for (;;) {
+        xQueueReceive(writer_queue, &job, portMAX_DELAY);
+        if (job.seg == NULL) {
+            bool exit = job.len != 0;
+            xSemaphoreGive(writer_idle);
+            if (exit) {
+                break;
+            }
+            continue;
+        }
+
+        // After a failure the rest is dropped; the network side sees storage_error
+        if (storage_error) {
+            buf_pool_release(download_pool, job.seg);
+            continue;
+        }
+
+        // The segment travels down the chain, which returns it to the pool
+        stage_span_t span = {
+            .data = job.seg,
+            .len = job.len,
+            .release = release_segment,
+            .owner = download_pool,
+            .buf = job.seg,
+        };
+        TRACE_BEGIN(TRACE_FLUSH, job.len);
+        int64_t t0 = esp_timer_get_time();
+        esp_err_t err = STAGE_PUSH(total_bytes, &span);
+        uint32_t lat = (uint32_t)(esp_timer_get_time() - t0);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "❌ Storage write error (%s)", esp_err_to_name(err));
+            storage_error = true;
+        } else {
+            total_bytes += job.len;
+            metric_counter_add(&m_flash_bytes, job.len);
+        }
+        record_flush(lat);
+        writer_busy_us += lat;
+        TRACE_END(TRACE_FLUSH, job.len);
+    }
+    vTaskDelete(NULL);
+}
+
+// Wait until the writer has committed everything handed to it
+static void pipeline_drain(void)
+{
+    write_job_t marker = { NULL, 0 };
+    xQueueSend(writer_queue, &marker, portMAX_DELAY);
+    xSemaphoreTake(writer_idle, portMAX_DELAY);
+}
+
+// Hand the filled segments to the writer and carry on with fresh ones
+static void pipeline_submit(void)
+{
+    int64_t t0 = esp_timer_get_time();
+    size_t queued = 0;
+    for (size_t i = 0; queued < buffer_offset; i++) {
+        write_job_t job = { write_segments[i], buffer_offset - queued };
+        if (job.len > WRITE_SEGMENT_SIZE) {
+            job.len = WRITE_SEGMENT_SIZE;
+        }
+        xQueueSend(writer_queue, &job, portMAX_DELAY);
+        queued += job.len;
+
+        // Blocks while the writer is behind: that's the backpressure
+        uint8_t *fresh = buf_pool_acquire(download_pool, DOWNLOAD_POOL_WAIT_MS);
+        if (fresh == NULL) {
+            pipeline_drain();
+            fresh = buf_pool_acquire(download_pool, DOWNLOAD_POOL_WAIT_MS);
+        }
+        if (fresh == NULL) {
+            ESP_LOGE(TAG, "❌ No download buffer available");
+            storage_error = true;
+            write_segments[i] = write_segments[--segment_count];   // Slot i's buffer went to the writer
+            break;
+        }
+        write_segments[i] = fresh;
+    }
+    buffer_offset = 0;
+    net_stall_us += esp_timer_get_time() - t0;
+
+    if (!storage_error) {
+        adapt_write_buffer();
+    }
+}
 
 static void flush_write_buffer(void)
 {
-    if (file_handle && buffer_offset > 0 && !storage_error) {
-        size_t written = fwrite(write_buffer, 1, buffer_offset, file_handle);
-        if (written != buffer_offset) {
-            ESP_LOGE(TAG, "❌ Storage write error (%d)", ferror(file_handle));
+    if (chain && buffer_offset > 0 && !storage_error && pipeline_active) {
+        pipeline_submit();
+    } else if (chain && buffer_offset > 0 && !storage_error) {
+        TRACE_BEGIN(TRACE_FLUSH, buffer_offset);
+        int64_t t0 = esp_timer_get_time();
+        size_t written = 0;
+        esp_err_t err = ESP_OK;
+        for (size_t i = 0; written < buffer_offset; i++) {
+            size_t len = buffer_offset - written;
+            if (len > WRITE_SEGMENT_SIZE) {
+                len = WRITE_SEGMENT_SIZE;
+            }
+            // Borrowed: the segment stays in the write buffer
+            stage_span_t span = { .data = write_segments[i], .len = len };
+            err = STAGE_PUSH(total_bytes + written, &span);
+            if (err != ESP_OK) {
+                break;
+            }
+            written += len;
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "❌ Storage write error (%s)", esp_err_to_name(err));
             storage_error = true;
         } else {
             total_bytes += written;
         }
+        metric_counter_add(&m_flash_bytes, written);
         buffer_offset = 0; // reset
+        record_flush((uint32_t)(esp_timer_get_time() - t0));
+
+        if (!storage_error) {
+            adapt_write_buffer();
+        }
+        TRACE_END(TRACE_FLUSH, written);
+    }
+}
+
+static void rate_monitor_reset(rate_monitor_t *rm, int64_t now)
+{
+    memset(rm, 0, sizeof(*rm));
+    rm->start_us = now;
+}
+
+// Account `len` bytes at time `now`; returns the windowed rate in B/s,
+// or -1 while still inside the grace period.
+static int32_t rate_monitor_add(rate_monitor_t *rm, size_t len, int64_t now)
+{
+    int64_t elapsed_us = now - rm->start_us;
+    int64_t idx = elapsed_us / (RATE_BUCKET_MS * 1000);
+
+    // Zero the buckets we skipped over (a stall leaves them empty)
+    for (int64_t i = rm->newest + 1; i <= idx && i <= rm->newest + RATE_WINDOW_BUCKETS; i++) {
+        rm->bytes[i % RATE_WINDOW_BUCKETS] = 0;
+    }
+    if (idx > rm->newest) {
+        rm->newest = idx;
+    }
+    rm->bytes[idx % RATE_WINDOW_BUCKETS] += len;
+
+    if (elapsed_us < (int64_t)RATE_GRACE_MS * 1000 ||
+        idx < RATE_WINDOW_BUCKETS) {
+        return -1;
+    }
+
+    uint64_t sum = 0;
+    for (int i = 0; i < RATE_WINDOW_BUCKETS; i++) {
+        sum += rm->bytes[i];
+    }
+    // Full older buckets plus the partial newest one
+    int64_t span_us = (int64_t)(RATE_WINDOW_BUCKETS - 1) * RATE_BUCKET_MS * 1000 +
+                      (elapsed_us - idx * RATE_BUCKET_MS * 1000);
+    return (int32_t)(sum * 1000000 / span_us);
+}
+
+// "bytes <first>-<last>/<complete>" (206) or "bytes */<complete>" (416)
+static void parse_content_range(const char *value)
+{
+    if (strncasecmp(value, "bytes ", 6) != 0) {
+        return;
+    }
+    value += 6;
+    if (*value != '*') {
+        range_start = strtoll(value, NULL, 10);
+    }
+    const char *slash = strchr(value, '/');
+    if (slash && slash[1] != '*') {
+        range_total = strtoll(slash + 1, NULL, 10);
+    }
+}
+
+// Validate the response once per attempt, before any body byte is stored
+static void check_response(esp_http_client_handle_t client)
+{
+    if (response_checked) {
+        return;
+    }
+    response_checked = true;
+    int status = http_status = esp_http_client_get_status_code(client);
+    bool mismatch = false;
+    if (status == 416 && resume_offset > 0) {
+        if (range_total < 0 || range_total == (int64_t)resume_offset) {
+            // Nothing left past our offset: the previous attempt already got it all
+            range_complete = true;
+            return;
+        }
+        ESP_LOGE(TAG, "❌ Resource is now %lld bytes, we have %u", range_total, (unsigned)resume_offset);
+        mismatch = true;
+    } else if (status == 206 && range_start != (int64_t)resume_offset) {
+        // Not the bytes we asked for; appending them would corrupt the file
+        ESP_LOGE(TAG, "❌ Content-Range starts at %lld, expected %u", range_start, (unsigned)resume_offset);
+        mismatch = true;
+    } else if (status == 206 && response_validator[0] && resume_validator[0] &&
+               strcmp(response_validator, resume_validator) != 0) {
+        // If-Range should have prevented this; some servers ignore it
+        ESP_LOGE(TAG, "❌ Resource changed since the first attempt");
+        mismatch = true;
+    }
+    if (mismatch) {
+        // Drop this response and start the file over on the next attempt
+        ESP_LOGW(TAG, "⚠️ Restarting from 0");
+        if (stage_reset(chain) != ESP_OK) {
+            storage_error = true;
+        }
+        total_bytes = 0;
+        resume_offset = 0;
+        http_error = true;
+        return;
+    }
+    if (status == 200 && resume_offset > 0) {
+        // Server ignored our Range header, or the file changed under If-Range: start over
+        ESP_LOGW(TAG, "⚠️ Server does not support resume, restarting from 0");
+        if (stage_reset(chain) != ESP_OK) {
+            storage_error = true;
+        }
+        total_bytes = 0;
+        resume_offset = 0;
+    } else if (status != 200 && status != 206) {
+        ESP_LOGE(TAG, "❌ HTTP status %d", status);
+        http_error = true;
+    }
+    if (status == 200 && !http_error) {
+        // Later attempts resume from this response only while the resource is unchanged
+        strcpy(resume_validator, response_validator);
+    }
+    if (http_error) {
+        return;
+    }
+
+    int64_t content_length = esp_http_client_get_content_length(client);
+    body_chunked = esp_http_client_is_chunked_response(client);
+    if (!body_has_length || body_chunked) {
+        ESP_LOGI(TAG, "📏 No Content-Length (%s body), reserving space in %d KB steps",
+                 body_chunked ? "chunked" : "close-delimited", RESERVE_STEP_BYTES / 1024);
+    } else if (!http_error && max_body_bytes > 0 && (int64_t)resume_offset + content_length > (int64_t)max_body_bytes) {
+        ESP_LOGE(TAG, "❌ Body of %lld bytes exceeds the %u byte cap",
+                 (int64_t)resume_offset + content_length, (unsigned)max_body_bytes);
+        size_exceeded = true;
+        return;
+    }
+
+    // 🚀 Known length: reserve it all now instead of checking space chunk by chunk
+    if (!http_error && !storage_error && content_length > 0) {
+        int64_t t0 = esp_timer_get_time();
+        esp_err_t err = stage_reserve(chain, (size_t)content_length);
+        stats.reserve_us += (uint32_t)(esp_timer_get_time() - t0);
+        if (err == ESP_ERR_NO_MEM) {
+            ESP_LOGE(TAG, "❌ Not enough space for %lld bytes", content_length);
+            storage_error = true;
+        } else if (err == ESP_OK) {
+            space_reserved = true;
+            stats.reserved_bytes = (size_t)content_length;
+        }
+    }
+}
+
+// Check free space before buffering. Without a Content-Length space is reserved
+// in RESERVE_STEP_BYTES steps, so the check runs once per step instead of per chunk.
+static bool reserve_space(size_t len)
+{
+    if (space_reserved || attempt_received + len <= reserved_until) {
+        return true;
+    }
+    size_t step = len > RESERVE_STEP_BYTES ? len : RESERVE_STEP_BYTES;
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = stage_reserve(chain, step);
+    if (err == ESP_ERR_NO_MEM && step > len) {
+        step = len;         // Nearly full: a whole step won't fit, but this chunk may
+        err = stage_reserve(chain, step);
+    }
+    stats.reserve_us += (uint32_t)(esp_timer_get_time() - t0);
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        size_t total = 0, used = 0;
+        err = ESP_OK;
+        TRACE_BEGIN(TRACE_SPIFFS_INFO, 0);
+        esp_err_t info_err = esp_spiffs_info(SPIFFS_PARTITION_LABEL, &total, &used);
+        TRACE_END(TRACE_SPIFFS_INFO, 0);
+        if (info_err == ESP_OK) {
+            size_t free_space = total - used;
+            if (free_space < len) {
+                err = ESP_ERR_NO_MEM;
+            } else if (free_space < step) {
+                step = free_space;
+            }
+        }
+    }
+    if (err == ESP_ERR_NO_MEM) {
+        ESP_LOGE(TAG, "❌ Out of SPIFFS space! Aborting...");
+        storage_error = true;
+        return false;
+    }
+    reserved_until = attempt_received + step;
+    stats.reserve_steps++;
+    return true;
+}
+
+// Below this the link counts as trickling. A configured rate limit caps the
+// rate on purpose (directly, or through flash backpressure), so judge against
+// half of the tightest limit instead of the fixed floor.
+static uint32_t slow_abort_bps(void)
+{
+    uint32_t bps = SLOW_ABORT_BPS;
+    uint32_t limits[] = { net_limiter.rate_bps, flash_limiter.rate_bps };
+    for (size_t i = 0; i < sizeof(limits) / sizeof(limits[0]); i++) {
+        if (limits[i] > 0 && limits[i] / 2 < bps) {
+            bps = limits[i] / 2;
+        }
+    }
+    return bps;
+}
+
+// Body bytes still allowed under the cap, SIZE_MAX when there is none
+static size_t cap_left(void)
+{
+    if (max_body_bytes == 0) {
+        return SIZE_MAX;
+    }
+    size_t body = resume_offset + attempt_received;
+    return body < max_body_bytes ? max_body_bytes - body : 0;
+}
+
+// Checked before `len` received bytes are buffered, so nothing past the cap is stored
+static bool cap_exceeded(size_t len)
+{
+    if (len <= cap_left()) {
+        return false;
+    }
+    ESP_LOGE(TAG, "❌ Body exceeds the %u byte cap, aborting", (unsigned)max_body_bytes);
+    size_exceeded = true;
+    return true;
+}
+
+// First-byte timestamp and live rate check for `len` freshly received bytes
+static void account_received(size_t len)
+{
+    rate_limiter_consume(&net_limiter, len);
+
+    int64_t now = esp_timer_get_time();
+    if (attempt_received == 0 && len > 0) {
+        metric_histogram_observe(&m_first_byte_us, (uint32_t)(now - start_time));
+    }
+    attempt_received += len;
+    stats.wire_bytes += len;
+    metric_counter_add(&m_net_bytes, len);
+    if (first_byte_time == 0 && len > 0) {
+        first_byte_time = now;
+    }
+    if (rate_monitor_enabled && !slow_abort) {
+        int32_t bps = rate_monitor_add(&rate, len, now);
+        uint32_t floor_bps = slow_abort_bps();
+        if (bps >= 0 && (uint32_t)bps < floor_bps) {
+            LOG_RATELIMIT_W(WARN_INTERVAL_MS, TAG, "🐢 Throughput %d B/s below %u B/s, reconnecting",
+                     (int)bps, (unsigned)floor_bps);
+            slow_abort = true;
+            metric_counter_add(&m_slow_aborts, 1);
+        }
     }
 }
 
 static esp_err_t _http_event_handler(esp_http_client_event_t *evt)
 {
+    TRACE_INSTANT(TRACE_HTTP_EVENT, evt->event_id);
     switch (evt->event_id) {
         case HTTP_EVENT_ERROR:
-            ESP_LOGE(TAG, "HTTP_EVENT_ERROR");
+            LOG_RATELIMIT_E(WARN_INTERVAL_MS, TAG, "HTTP_EVENT_ERROR");
             break;
 
         case HTTP_EVENT_ON_CONNECTED:
-            ESP_LOGI(TAG, "HTTP_EVENT_ON_CONNECTED");
+            HOT_LOGI(TAG, "HTTP_EVENT_ON_CONNECTED");
             break;
 
         case HTTP_EVENT_HEADER_SENT:
-            ESP_LOGI(TAG, "HTTP_EVENT_HEADER_SENT");
+            HOT_LOGI(TAG, "HTTP_EVENT_HEADER_SENT");
+            // Also sent again for each redirect hop
+            body_has_length = false;
+            range_start = range_total = -1;
+            response_validator[0] = '\0';
             break;
 
         case HTTP_EVENT_ON_HEADER:
-            ESP_LOGI(TAG, "Header: %s = %s", evt->header_key, evt->header_value);
+            HOT_LOGD(TAG, "Header: %s = %s", evt->header_key, evt->header_value);
+            if (strcasecmp(evt->header_key, "Content-Length") == 0) {
+                body_has_length = true;
+            } else if (strcasecmp(evt->header_key, "Content-Range") == 0) {
+                parse_content_range(evt->header_value);
+            } else if (strcasecmp(evt->header_key, "ETag") == 0 &&
+                       strncmp(evt->header_value, "W/", 2) != 0) {
+                // Weak ETags can't be used with If-Range; a strong one beats Last-Modified
+                snprintf(response_validator, sizeof(response_validator), "%s", evt->header_value);
+            } else if (strcasecmp(evt->header_key, "Last-Modified") == 0 &&
+                       response_validator[0] != '"') {
+                snprintf(response_validator, sizeof(response_validator), "%s", evt->header_value);
+            }
             break;
 
         case HTTP_EVENT_ON_DATA:
-            if (evt->data && evt->data_len > 0 && file_handle && !storage_error) {
-                // Check free space before buffering
-                size_t total = 0, used = 0;
-                if (esp_spiffs_info("spiffs", &total, &used) == ESP_OK) {
-                    size_t free_space = total - used;
-                    if (free_space < evt->data_len) {
-                        ESP_LOGE(TAG, "❌ Out of SPIFFS space! Aborting...");
-                        storage_error = true;
-                        break;
-                    }
+            // In pull mode the body is read straight into write_buffer by download_pull()
+            if (pull_mode) {
+                break;
+            }
+            check_response(evt->client);
+            if (evt->data && evt->data_len > 0 && chain && !storage_error && !http_error &&
+                !size_exceeded && !range_complete) {
+                if (cap_exceeded(evt->data_len)) {
+                    esp_http_client_close(evt->client);
+                    break;
+                }
+                if (!reserve_space(evt->data_len)) {
+                    break;
                 }
+#if FAULT_INJECT_ENABLED
+                if (fault_net_receive(resume_offset + attempt_received, evt->data_len,
+                                      HTTP_TIMEOUT_MS) != ESP_OK) {
+                    esp_http_client_close(evt->client);
+                    break;
+                }
+#endif
 
                 // 🚀 Buffer the data
                 size_t remaining = evt->data_len;
                 const uint8_t *ptr = (const uint8_t *)evt->data;
 
                 while (remaining > 0 && !storage_error) {
-                    size_t space_left = WRITE_BUFFER_SIZE - buffer_offset;
+                    size_t space_left;
+                    uint8_t *tail = buffer_tail(&space_left);
                     size_t to_copy = (remaining < space_left) ? remaining : space_left;
 
-                    memcpy(write_buffer + buffer_offset, ptr, to_copy);
+                    TRACE_BEGIN(TRACE_MEMCPY, to_copy);
+                    memcpy(tail, ptr, to_copy);
+                    TRACE_END(TRACE_MEMCPY, to_copy);
                     buffer_offset += to_copy;
                     ptr += to_copy;
                     remaining -= to_copy;
 
                     // 🚀 Flush when buffer is full
-                    if (buffer_offset == WRITE_BUFFER_SIZE) {
+                    if (buffer_offset == buffer_capacity()) {
                         flush_write_buffer();
                     }
                 }
+
+                account_received(evt->data_len);
+                if (slow_abort || size_exceeded) {
+                    // Makes the in-flight read fail so perform() returns promptly
+                    esp_http_client_close(evt->client);
+                }
             }
             break;
 
         case HTTP_EVENT_ON_FINISH:
-            ESP_LOGI(TAG, "HTTP_EVENT_ON_FINISH");
+            HOT_LOGI(TAG, "HTTP_EVENT_ON_FINISH");
             // 🚀 Flush any remaining data
             flush_write_buffer();
             break;
 
         case HTTP_EVENT_DISCONNECTED:
-            ESP_LOGW(TAG, "HTTP_EVENT_DISCONNECTED");
+            HOT_LOGI(TAG, "HTTP_EVENT_DISCONNECTED");
             break;
 
         case HTTP_EVENT_REDIRECT:
@@ -113,84 +758,1070 @@ static esp_err_t _http_event_handler(esp_http_client_event_t *evt)
     return ESP_OK;
 }
 
+// Chunked bodies end with the terminating chunk, close-delimited ones at a real EOF
+static bool body_complete(esp_http_client_handle_t client)
+{
+    if (response_checked && !body_has_length && !body_chunked) {
+        return body_eof;
+    }
+    return esp_http_client_is_complete_data_received(client);
+}
+
+// 🚀 Pull mode: read the body directly into write_buffer, no intermediate memcpy.
+// The client's own RX buffer only stages TLS records, so it can stay small.
+static esp_err_t download_pull(esp_http_client_handle_t client)
+{
+    esp_err_t err;
+
+    // perform() follows redirects internally; here we have to do it ourselves
+    for (int redirects = 0; ; redirects++) {
+        err = esp_http_client_open(client, 0);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (esp_http_client_fetch_headers(client) < 0) {
+            esp_http_client_close(client);
+            return ESP_FAIL;
+        }
+        int status = esp_http_client_get_status_code(client);
+        bool is_redirect = status == 301 || status == 302 || status == 303 ||
+                           status == 307 || status == 308;
+        if (!is_redirect || redirects >= MAX_REDIRECTS) {
+            break;
+        }
+        esp_http_client_set_redirection(client);
+        esp_http_client_close(client);
+    }
+    check_response(client);
+
+    while (chain && !storage_error && !http_error && !slow_abort && !size_exceeded && !range_complete) {
+        size_t space_left;
+        uint8_t *tail = buffer_tail(&space_left);
+        if (!reserve_space(space_left)) {
+            break;
+        }
+
+        if (net_limiter.rate_bps > 0 && space_left > RATE_LIMIT_BURST) {
+            space_left = RATE_LIMIT_BURST;      // Smaller reads pace more smoothly
+        }
+        // At most one byte past the cap: enough to tell the body is too long
+        size_t allowed = cap_left();
+        if (space_left > allowed) {
+            space_left = allowed + 1;
+        }
+        TRACE_BEGIN(TRACE_NET_READ, space_left);
+        int64_t read_start = esp_timer_get_time();
+        errno = 0;
+        int len = esp_http_client_read(client, (char *)tail, space_left);
+        TRACE_END(TRACE_NET_READ, len);
+#if FAULT_INJECT_ENABLED
+        if (len > 0 && fault_net_receive(resume_offset + attempt_received, len,
+                                         HTTP_TIMEOUT_MS) != ESP_OK) {
+            len = -1;           // Bytes of the failed read are lost, as with a real reset
+        }
+#endif
+        if (len < 0) {
+            err = ESP_FAIL;
+            break;
+        }
+        if (len == 0) {
+            // A read timeout also returns 0: only a prompt return without EAGAIN is
+            // the server closing the connection, which ends a close-delimited body
+            body_eof = errno != EAGAIN && errno != EWOULDBLOCK &&
+                       esp_timer_get_time() - read_start < (int64_t)HTTP_TIMEOUT_MS * 1000;
+            if (!body_complete(client)) {
+                err = ESP_FAIL;     // Connection closed early or read timed out
+            }
+            break;
+        }
+
+        if (cap_exceeded(len)) {
+            break;                  // The read sits past buffer_offset and is dropped
+        }
+        buffer_offset += len;
+        if (buffer_offset == buffer_capacity()) {
+            flush_write_buffer();
+        }
+        account_received(len);
+    }
+
+    // Leave a cleanly finished connection open for the next request of a session
+    if (!(session_active && err == ESP_OK && !storage_error && !http_error && !slow_abort &&
+          !size_exceeded && esp_http_client_is_complete_data_received(client))) {
+        esp_http_client_close(client);
+    }
+    return err;
+}
+
+// Done with an attempt's client: a session keeps it if the attempt went well
+static void release_client(esp_http_client_handle_t client, bool ok)
+{
+    if (session_active && ok) {
+        session_client = client;
+        return;
+    }
+    if (client == session_client) {
+        session_client = NULL;
+    }
+    esp_http_client_cleanup(client);
+}
+
+// NVS keys are limited to 15 chars, so mirrors are keyed by an FNV-1a hash of the URL
+static void mirror_nvs_key(const char *url, char key[16])
+{
+    uint32_t h = 2166136261u;
+    for (const char *p = url; *p; p++) {
+        h = (h ^ (uint8_t)*p) * 16777619u;
+    }
+    snprintf(key, 16, "m%08lx", (unsigned long)h);
+}
+
+static uint32_t mirror_seq = 0;           // Downloads ranked so far
+static uint32_t mirror_seq_limit = 0;     // Ceiling stored in NVS, 0 until loaded
+
+// Remembered score into m->saved; m->bps is 0 if there is none or it is older
+// than MIRROR_MAX_AGE downloads
+static void mirror_load(mirror_t *m)
+{
+    nvs_handle_t nvs;
+    size_t len = sizeof(m->saved);
+    char key[16];
+    mirror_nvs_key(m->url, key);
+    m->saved = (mirror_score_t) {0};
+    if (nvs_open(MIRROR_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        if (nvs_get_blob(nvs, key, &m->saved, &len) != ESP_OK || len != sizeof(m->saved)) {
+            m->saved = (mirror_score_t) {0};
+        }
+        nvs_close(nvs);
+    }
+    m->bps = (mirror_seq - m->saved.seq < MIRROR_MAX_AGE) ? m->saved.bps : 0;
+}
+
+static void mirror_save(mirror_t *m)
+{
+    nvs_handle_t nvs;
+    mirror_score_t score = { m->bps, mirror_seq };
+    char key[16];
+    mirror_nvs_key(m->url, key);
+    if (nvs_open(MIRROR_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        if (nvs_set_blob(nvs, key, &score, sizeof(score)) == ESP_OK && nvs_commit(nvs) == ESP_OK) {
+            m->saved = score;
+        }
+        nvs_close(nvs);
+    }
+}
+
+static void mirror_record_bps(mirror_t *m, uint32_t sample_bps)
+{
+    if (m->bps <= 1) {
+        m->bps = sample_bps;
+    } else {
+        m->bps = m->bps - (m->bps >> MIRROR_EWMA_SHIFT) + (sample_bps >> MIRROR_EWMA_SHIFT);
+    }
+    // NVS only hears about real changes, or before the stored score would expire
+    uint32_t delta = m->bps > m->saved.bps ? m->bps - m->saved.bps : m->saved.bps - m->bps;
+    if (m->saved.bps <= 1 || delta > (m->saved.bps >> MIRROR_SAVE_SHIFT) ||
+        mirror_seq - m->saved.seq >= MIRROR_MAX_AGE / 2) {
+        mirror_save(m);
+    }
+}
+
+// Advance the download counter that ages the stored scores. NVS holds a ceiling
+// MIRROR_SEQ_STEP ahead, so it is written once per step instead of per download;
+// after a reboot the count resumes from the ceiling, which only ages scores sooner
+static void mirror_next_seq(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(MIRROR_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        mirror_seq++;
+        return;
+    }
+    if (mirror_seq_limit == 0) {
+        nvs_get_u32(nvs, MIRROR_SEQ_KEY, &mirror_seq);
+        mirror_seq_limit = mirror_seq;
+    }
+    mirror_seq++;
+    if (mirror_seq >= mirror_seq_limit) {
+        mirror_seq_limit = mirror_seq + MIRROR_SEQ_STEP;
+        if (nvs_set_u32(nvs, MIRROR_SEQ_KEY, mirror_seq_limit) == ESP_OK) {
+            nvs_commit(nvs);
+        }
+    }
+    nvs_close(nvs);
+}
+
+// Time a small ranged GET, TLS handshake included, since that's what a download pays too.
+// Pulled, not performed: a mirror that ignores Range must not send us the whole file
+static uint32_t mirror_probe_bps(const char *url)
+{
+    esp_http_client_config_t config = {
+        .url = url,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .timeout_ms = HTTP_TIMEOUT_MS,
+        .buffer_size = PULL_RX_BUFFER_SIZE,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    char *buf = malloc(PULL_RX_BUFFER_SIZE);
+    if (client == NULL || buf == NULL) {
+        if (client) {
+            esp_http_client_cleanup(client);
+        }
+        free(buf);
+        return 0;
+    }
+
+    char range[32];
+    snprintf(range, sizeof(range), "bytes=0-%d", MIRROR_PROBE_BYTES - 1);
+    esp_http_client_set_header(client, "Range", range);
+
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err;
+    int status = 0;
+    for (int redirects = 0; ; redirects++) {
+        err = esp_http_client_open(client, 0);
+        if (err == ESP_OK && esp_http_client_fetch_headers(client) < 0) {
+            err = ESP_FAIL;
+        }
+        if (err != ESP_OK) {
+            break;
+        }
+        status = esp_http_client_get_status_code(client);
+        bool is_redirect = status == 301 || status == 302 || status == 303 ||
+                           status == 307 || status == 308;
+        if (!is_redirect || redirects >= MAX_REDIRECTS) {
+            break;
+        }
+        esp_http_client_set_redirection(client);
+        esp_http_client_close(client);
+    }
+
+    size_t received = 0;
+    while (err == ESP_OK && (status == 200 || status == 206) && received < MIRROR_PROBE_BYTES) {
+        size_t want = MIRROR_PROBE_BYTES - received;
+        int len = esp_http_client_read(client, buf, want < PULL_RX_BUFFER_SIZE ? want : PULL_RX_BUFFER_SIZE);
+        if (len < 0) {
+            err = ESP_FAIL;
+        }
+        if (len <= 0) {
+            break;                  // A body shorter than the probe still times the link
+        }
+        received += len;
+    }
+    int64_t elapsed_us = esp_timer_get_time() - t0;
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    free(buf);
+
+    if (err != ESP_OK || (status != 200 && status != 206) || received == 0 || elapsed_us <= 0) {
+        ESP_LOGW(TAG, "⚠️ Probe of %s failed (err=%s, status=%d)", url, esp_err_to_name(err), status);
+        return 0;
+    }
+    return (uint32_t)((uint64_t)received * 1000000 / elapsed_us);
+}
+
+// Sort mirrors fastest first. Mirrors without a fresh score are probed and the
+// result is kept, so each one is probed at most once per MIRROR_MAX_AGE
+// downloads; failed probes go last. A lone mirror has nothing to be ranked
+// against, so it is neither scored nor persisted.
+static void mirror_rank(mirror_t *mirrors, size_t count)
+{
+    if (count < 2) {
+        mirrors[0].bps = 0;
+        mirrors[0].saved = (mirror_score_t) {0};
+        return;
+    }
+    mirror_next_seq();
+    for (size_t i = 0; i < count; i++) {
+        mirror_load(&mirrors[i]);
+        if (mirrors[i].bps == 0) {
+            uint32_t bps = mirror_probe_bps(mirrors[i].url);
+            mirrors[i].bps = bps > 0 ? bps : 1;
+            mirror_save(&mirrors[i]);
+        }
+        ESP_LOGI(TAG, "🪞 Mirror %s: %u B/s", mirrors[i].url, (unsigned)mirrors[i].bps);
+    }
+
+    // Insertion sort, count is tiny
+    for (size_t i = 1; i < count; i++) {
+        mirror_t m = mirrors[i];
+        size_t j = i;
+        while (j > 0 && mirrors[j - 1].bps < m.bps) {
+            mirrors[j] = mirrors[j - 1];
+            j--;
+        }
+        mirrors[j] = m;
+    }
+}
+
+// Full-jitter exponential backoff: uniform in [0, min(max, base * 2^n)]
+static uint32_t backoff_delay_ms(int failures)
+{
+    uint32_t ceiling = BACKOFF_MAX_MS;
+    if (failures < 16) {
+        uint32_t exp = BACKOFF_BASE_MS << failures;
+        if (exp < ceiling) {
+            ceiling = exp;
+        }
+    }
+    return esp_random() % (ceiling + 1);
+}
+
+// ---- Default terminal stage: one plain file on SPIFFS ----
+
+typedef struct {
+    FILE *f;
+    const char *path;
+    bool active;                // Download in progress; readers must stay below committed
+    bool followed;              // A reader polled progress during this download
+    size_t written;             // Bytes handed to stdio
+    size_t committed;           // Bytes flushed to SPIFFS, visible to other FILEs
+    uint32_t generation;        // Bumped when a retry truncates the file
+} file_stage_ctx_t;
+
+static portMUX_TYPE file_progress_lock = portMUX_INITIALIZER_UNLOCKED;
+
+typedef struct {
+    const char *path;
+    https_file_watch_cb_t cb;
+    void *ctx;
+} file_watch_t;
+
+static file_watch_t file_watches[FILE_WATCH_MAX];
+static SemaphoreHandle_t file_watch_lock = NULL;  // Held while callbacks run
+
+static file_stage_ctx_t file_stage_ctx;
+static stage_t file_stage;
+
+static bool encrypt_files = false;        // Put crypt_stage in front of file_stage
+static uint8_t encrypt_key[CRYPT_KEY_SIZE];
+static crypt_stage_ctx_t crypt_ctx;
+static stage_t crypt_stage;
+
+static SemaphoreHandle_t file_watch_get_lock(void)
+{
+    if (file_watch_lock == NULL) {
+        SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+        portENTER_CRITICAL(&file_progress_lock);
+        if (file_watch_lock == NULL) {
+            file_watch_lock = lock;
+            lock = NULL;
+        }
+        portEXIT_CRITICAL(&file_progress_lock);
+        if (lock) {
+            vSemaphoreDelete(lock);
+        }
+    }
+    return file_watch_lock;
+}
+
+static void file_watch_notify(const char *path, https_file_event_t event,
+                              const uint8_t *data, size_t len, size_t offset)
+{
+    if (file_watch_lock == NULL) {
+        return;                 // Nobody has ever watched a file
+    }
+    xSemaphoreTake(file_watch_lock, portMAX_DELAY);
+    for (size_t i = 0; i < FILE_WATCH_MAX; i++) {
+        if (file_watches[i].cb && strcmp(file_watches[i].path, path) == 0) {
+            file_watches[i].cb(file_watches[i].ctx, event, data, len, offset);
+        }
+    }
+    xSemaphoreGive(file_watch_lock);
+}
+
+static bool file_watch_active(const char *path)
+{
+    if (file_watch_lock == NULL) {
+        return false;
+    }
+    bool found = false;
+    xSemaphoreTake(file_watch_lock, portMAX_DELAY);
+    for (size_t i = 0; i < FILE_WATCH_MAX && !found; i++) {
+        found = file_watches[i].cb && strcmp(file_watches[i].path, path) == 0;
+    }
+    xSemaphoreGive(file_watch_lock);
+    return found;
+}
+
+static esp_err_t file_stage_push(stage_t *s, stage_span_t *span)
+{
+    file_stage_ctx_t *fs = s->ctx;
+    esp_err_t err = ESP_OK;
+    size_t offset = fs->written;
+    if (fwrite(span->data, 1, span->len, fs->f) != span->len) {
+        ESP_LOGE(TAG, "❌ fwrite failed (%d)", ferror(fs->f));
+        err = ESP_FAIL;
+    } else {
+        fs->written += span->len;
+        // fflush only empties stdio, fsync also commits SPIFFS's per-fd cache so
+        // readers on another fd see the bytes. Each sync rewrites the partly filled
+        // last page, so only sync every span while someone follows the file
+        bool followed = fs->followed || file_watch_active(fs->path);
+        if (followed || fs->written - fs->committed >= FILE_SYNC_INTERVAL) {
+            if (fflush(fs->f) != 0 || fsync(fileno(fs->f)) != 0) {
+                ESP_LOGE(TAG, "❌ fsync failed (%d)", errno);
+                err = ESP_FAIL;
+            } else {
+                portENTER_CRITICAL(&file_progress_lock);
+                fs->committed = fs->written;
+                portEXIT_CRITICAL(&file_progress_lock);
+            }
+        }
+    }
+    if (err == ESP_OK) {
+        file_watch_notify(fs->path, HTTPS_FILE_DATA, span->data, span->len, offset);
+    }
+    stage_span_release(span);
+    return err;
+}
+
+static void file_stage_set_progress(file_stage_ctx_t *fs, https_file_event_t event)
+{
+    portENTER_CRITICAL(&file_progress_lock);
+    fs->active = event == HTTPS_FILE_STARTED;
+    if (event == HTTPS_FILE_STARTED) {
+        fs->written = 0;
+        fs->committed = 0;
+        fs->generation++;
+    }
+    portEXIT_CRITICAL(&file_progress_lock);
+    file_watch_notify(fs->path, event, NULL, 0, 0);
+}
+
+static esp_err_t file_stage_reset(stage_t *s)
+{
+    file_stage_ctx_t *fs = s->ctx;
+    fs->f = freopen(fs->path, "wb", fs->f);
+    if (!fs->f) {
+        ESP_LOGE(TAG, "❌ Failed to reopen %s (errno %d)", fs->path, errno);
+        return ESP_FAIL;        // abort() reports the failure to watchers
+    }
+    file_stage_set_progress(fs, HTTPS_FILE_STARTED);
+    return ESP_OK;
+}
+
+static esp_err_t file_stage_finish(stage_t *s)
+{
+    file_stage_ctx_t *fs = s->ctx;
+    int err = fs->f ? fclose(fs->f) : EOF;
+    fs->f = NULL;
+    file_stage_set_progress(fs, err == 0 ? HTTPS_FILE_DONE : HTTPS_FILE_FAILED);
+    return err == 0 ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t file_stage_reserve(stage_t *s, size_t bytes)
+{
+    return spiffs_reserve(bytes);
+}
+
+static void file_stage_abort(stage_t *s)
+{
+    file_stage_ctx_t *fs = s->ctx;
+    if (fs->f) {
+        fclose(fs->f);
+        fs->f = NULL;
+    }
+    file_stage_set_progress(fs, HTTPS_FILE_FAILED);
+}
+
 esp_err_t https_download_file(const char *url, const char *filepath)
+{
+    return https_download_file_mirrors(&url, 1, filepath);
+}
+
+esp_err_t https_download_file_mirrors(const char *const *urls, size_t url_count, const char *filepath)
+{
+    // ✅ Remove any existing file before writing
+    unlink(filepath);
+
+    file_stage_ctx.path = filepath;
+    file_stage_ctx.followed = false;
+    file_stage_ctx.f = fopen(filepath, "wb");
+    if (!file_stage_ctx.f) {
+        ESP_LOGE(TAG, "❌ Failed to open file for writing: %s", filepath);
+        ESP_LOGE(TAG, "   errno = %d (%s)", errno, strerror(errno));
+        return ESP_FAIL;
+    }
+
+    file_stage = (stage_t) {
+        .name = "spiffs_file",
+        .push = file_stage_push,
+        .reset = file_stage_reset,
+        .reserve = file_stage_reserve,
+        .finish = file_stage_finish,
+        .abort = file_stage_abort,
+        .ctx = &file_stage_ctx,
+    };
+    file_stage_set_progress(&file_stage_ctx, HTTPS_FILE_STARTED);
+    if (encrypt_files) {
+        crypt_stage_init(&crypt_stage, &crypt_ctx, encrypt_key, &file_stage);
+        return https_download_to_stage(urls, url_count, &crypt_stage);
+    }
+    return https_download_to_stage(urls, url_count, &file_stage);
+}
+
+static esp_err_t download_mirrors(const char *const *urls, size_t url_count)
 {
     esp_err_t ret = ESP_FAIL;
+    int64_t deadline = esp_timer_get_time() + (int64_t)DOWNLOAD_DEADLINE_MS * 1000;
+    int failures = 0;
+    int slow_aborts = 0;
+
+    if (urls == NULL || url_count == 0 || url_count > MAX_MIRRORS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    mirror_t mirrors[MAX_MIRRORS];
+    for (size_t i = 0; i < url_count; i++) {
+        mirrors[i].url = urls[i];
+        mirrors[i].dead = false;
+    }
+    mirror_rank(mirrors, url_count);
+    size_t current = 0;
+    size_t round_failures = 0;
+
+    total_bytes = 0;
+    resume_validator[0] = '\0';
+    rate_monitor_enabled = true;
+
+    for (int attempt = 1; ; attempt++) {
+        int64_t now = esp_timer_get_time();
+        if (now >= deadline) {
+            ESP_LOGE(TAG, "❌ Download deadline of %d ms exceeded", DOWNLOAD_DEADLINE_MS);
+            return ESP_ERR_TIMEOUT;
+        }
+
+        // Don't spend an attempt while the link is down; wait for it instead
+        uint32_t remaining_ms = (uint32_t)((deadline - now) / 1000);
+        if (wifi_wait_ready(WIFI_CONNECTED_BIT, remaining_ms) != ESP_OK) {
+            ESP_LOGE(TAG, "❌ Wi-Fi not back before deadline");
+            return ESP_ERR_TIMEOUT;
+        }
 
-    for (int attempt = 1; attempt <= MAX_RETRIES; attempt++) {
-        ESP_LOGI(TAG, "🌍 Attempt %d to download %s", attempt, url);
+        mirror_t *mirror = &mirrors[current];
+        ESP_LOGI(TAG, "🌍 Attempt %d to download %s (from byte %u)", attempt, mirror->url, total_bytes);
 
         esp_http_client_config_t config = {
-            .url = url,
+            .url = mirror->url,
             .event_handler = _http_event_handler,
             .crt_bundle_attach = esp_crt_bundle_attach,
             .timeout_ms = HTTP_TIMEOUT_MS,
-            .buffer_size = 32768,   // 🚀 Larger RX buffer
+            .buffer_size = pull_mode ? PULL_RX_BUFFER_SIZE : HTTP_RX_BUFFER_SIZE,   // 🚀 Larger RX buffer
             .buffer_size_tx = 8192 // 🚀 Larger TX buffer
         };
 
-        esp_http_client_handle_t client = esp_http_client_init(&config);
-        if (client == NULL) {
-            ESP_LOGE(TAG, "❌ Failed to initialize HTTP client");
-            return ESP_FAIL;
+        esp_http_client_handle_t client = session_client;
+        if (client != NULL) {
+            // Same host keeps the open connection; a different one reconnects
+            esp_http_client_set_url(client, mirror->url);
+        } else {
+            client = esp_http_client_init(&config);
+            if (client == NULL) {
+                ESP_LOGE(TAG, "❌ Failed to initialize HTTP client");
+                return ESP_FAIL;
+            }
         }
 
-        // ✅ Remove any existing file before writing
-        unlink(filepath);
-
-        file_handle = fopen(filepath, "wb");
-        if (!file_handle) {
-            ESP_LOGE(TAG, "❌ Failed to open file for writing: %s", filepath);
-            ESP_LOGE(TAG, "   errno = %d (%s)", errno, strerror(errno));
-            esp_http_client_cleanup(client);
-            return ESP_FAIL;
+        // 🚀 Resume after the bytes already committed instead of starting over
+        resume_offset = total_bytes;
+        if (resume_offset > 0) {
+            char range[32];
+            snprintf(range, sizeof(range), "bytes=%u-", resume_offset);
+            esp_http_client_set_header(client, "Range", range);
+            if (resume_validator[0]) {
+                // A changed resource comes back whole (200) instead of a mismatched tail
+                esp_http_client_set_header(client, "If-Range", resume_validator);
+            } else {
+                esp_http_client_delete_header(client, "If-Range");
+            }
+        } else {
+            esp_http_client_delete_header(client, "Range");
+            esp_http_client_delete_header(client, "If-Range");
         }
 
-        total_bytes = 0;
+        size_t attempt_start_bytes = total_bytes;
         storage_error = false;
+        http_error = false;
+        response_checked = false;
+        space_reserved = false;
+        reserved_until = 0;
+        body_has_length = false;
+        body_chunked = false;
+        body_eof = false;
+        size_exceeded = false;
+        range_complete = false;
+        range_start = range_total = -1;
+        response_validator[0] = '\0';
+        http_status = 0;
         buffer_offset = 0;
+        attempt_received = 0;
+        slow_abort = false;
         start_time = esp_timer_get_time();
+        rate_monitor_reset(&rate, start_time);
 
-        ret = esp_http_client_perform(client);
+        metric_counter_add(&m_attempts, 1);
+        stats.attempts++;
+        ret = ESP_OK;
+#if FAULT_INJECT_ENABLED
+        ret = fault_connect(attempt);
+#endif
+        if (ret == ESP_OK) {
+            ret = pull_mode ? download_pull(client) : esp_http_client_perform(client);
+        }
 
-        // 🚀 Flush any last buffered data
+        // 🚀 Flush any last buffered data; a partial body is still a valid prefix
         flush_write_buffer();
+        if (pipeline_active) {
+            pipeline_drain();       // total_bytes must be final before resuming from it
+        }
+        if (chain && !storage_error && stage_flush(chain) != ESP_OK) {
+            storage_error = true;
+        }
 
-        fclose(file_handle);
-        file_handle = NULL;
+        if (ret == ESP_OK && !response_checked) {
+            check_response(client);     // Event mode with an empty body: no ON_DATA
+        }
+        if (ret == ESP_OK && range_complete) {
+            ESP_LOGI(TAG, "✅ Download complete. Total bytes: %d", total_bytes);
+            release_client(client, false);
+            return ESP_OK;
+        }
+        if (!response_checked) {
+            http_status = esp_http_client_get_status_code(client);
+            http_error = (http_status != 200 && http_status != 206);
+        }
+
+        if (ret == ESP_OK && !body_complete(client)) {
+            ret = ESP_ERR_INVALID_SIZE;
+        }
+
+        int64_t end_time = esp_timer_get_time();
+        size_t attempt_bytes = total_bytes - attempt_start_bytes;
+        if (url_count > 1 && attempt_bytes >= MIRROR_MIN_SAMPLE && end_time > start_time) {
+            mirror_record_bps(mirror, (uint32_t)((uint64_t)attempt_bytes * 1000000 / (end_time - start_time)));
+        }
 
-        if (ret == ESP_OK && !storage_error) {
-            int64_t end_time = esp_timer_get_time();
+        if (ret == ESP_OK && !storage_error && !http_error && !slow_abort && !size_exceeded) {
             double elapsed_sec = (end_time - start_time) / 1000000.0;
-            double speed = (total_bytes / 1024.0) / elapsed_sec; // KBps
+            double speed = ((total_bytes - attempt_start_bytes) / 1024.0) / elapsed_sec; // KBps
 
-            ESP_LOGI(TAG, "📦 Downloaded %d bytes in %.2f sec (%.2f KB/s)",
-                     total_bytes, elapsed_sec, speed);
+            ESP_LOGI(TAG, "📦 Downloaded %d bytes in %.2f sec (%.2f KB/s, %s mode)",
+                     total_bytes - attempt_start_bytes, elapsed_sec, speed,
+                     pull_mode ? "pull" : "event");
 
-            if (speed < (MIN_SPEED_BPS / 1024.0)) {
-                ESP_LOGW(TAG, "⚠️ Download speed below 400 KBps requirement!");
+            if (speed < (MIN_SPEED_BPS / 1024.0) && slow_abort_bps() == SLOW_ABORT_BPS) {
+                LOG_RATELIMIT_W(WARN_INTERVAL_MS, TAG, "⚠️ Download speed below 400 KBps requirement!");
             }
 
             ESP_LOGI(TAG, "✅ Download complete. Total bytes: %d", total_bytes);
-            esp_http_client_cleanup(client);
+            release_client(client, true);
             return ESP_OK;
-        } else {
-            ESP_LOGE(TAG, "❌ Download failed (err=%s)", esp_err_to_name(ret));
+        }
 
-            if (storage_error) {
-                ESP_LOGE(TAG, "❌ Aborting due to storage error");
-                esp_http_client_cleanup(client);
-                return ESP_FAIL;
+        ESP_LOGE(TAG, "❌ Download failed (err=%s, status=%d)", esp_err_to_name(ret), http_status);
+        metric_counter_add(&m_failed_attempts, 1);
+        release_client(client, false);
+
+        if (storage_error) {
+            ESP_LOGE(TAG, "❌ Aborting due to storage error");
+            return ESP_FAIL;
+        }
+        if (size_exceeded) {
+            // Another mirror serves the same body, so retrying can't help
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (!pull_mode && response_checked && !body_has_length && !body_chunked) {
+            // perform() can't tell the server closing from a timeout, and neither can we
+            ESP_LOGE(TAG, "❌ Close-delimited body needs pull mode to detect its end");
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+
+        // Client errors won't fix themselves; timeouts and throttling might
+        if (http_error && http_status >= 400 && http_status < 500 &&
+            http_status != 408 && http_status != 416 && http_status != 429) {
+            mirror->dead = true;
+        }
+
+        // 🚀 Fail over to the next-best mirror; committed bytes carry over via Range
+        size_t tried = 0;
+        do {
+            current = (current + 1) % url_count;
+        } while (mirrors[current].dead && ++tried < url_count);
+        if (mirrors[current].dead) {
+            ESP_LOGE(TAG, "❌ Aborting due to HTTP status %d", http_status);
+            return ESP_FAIL;
+        }
+        if (url_count > 1) {
+            ESP_LOGW(TAG, "🪞 Failing over to %s", mirrors[current].url);
+        }
+
+        // A slow connection is replaced right away; the next one may land on a better path
+        if (slow_abort) {
+            if (++slow_aborts >= SLOW_ABORT_MAX) {
+                ESP_LOGW(TAG, "⚠️ Link is consistently slow, disabling slow-connection aborts");
+                rate_monitor_enabled = false;
             }
+            continue;
+        }
+        slow_aborts = 0;
+
+        // Progress means the path works; only back off hard on repeated dead attempts
+        if (total_bytes > attempt_start_bytes) {
+            failures = 0;
+        } else {
+            failures++;
+        }
+
+        // Only back off once every mirror has had its turn
+        if (++round_failures < url_count) {
+            continue;
+        }
+        round_failures = 0;
+        uint32_t backoff_ms = backoff_delay_ms(failures);
+        LOG_RATELIMIT_W(WARN_INTERVAL_MS, TAG, "⏳ Retrying in %u ms...", (unsigned)backoff_ms);
+        TRACE_BEGIN(TRACE_BACKOFF, backoff_ms);
+        vTaskDelay(pdMS_TO_TICKS(backoff_ms));
+        TRACE_END(TRACE_BACKOFF, backoff_ms);
+    }
+}
+
+typedef struct {
+    const char *const *urls;
+    size_t url_count;
+    esp_err_t ret;
+    SemaphoreHandle_t done;
+} net_job_t;
+
+static void net_task(void *arg)
+{
+    net_job_t *job = arg;
+    job->ret = download_mirrors(job->urls, job->url_count);
+    xSemaphoreGive(job->done);
+    vTaskDelete(NULL);
+}
+
+static BaseType_t pipeline_core(int core)
+{
+    return (core >= 0 && core < portNUM_PROCESSORS) ? core : tskNO_AFFINITY;
+}
+
+// Size the pool from what the heap can spare: PSRAM boards get a full pool,
+// others a few buffers, and never so many that internal RAM drops below the
+// reserve the network stack needs. Buffers are allocated lazily and recycled,
+// so one pool serves every download; it is only rebuilt, between downloads,
+// when the pipeline setting it was sized for changes.
+static buf_pool_t *download_pool_get(void)
+{
+    if (download_pool != NULL && download_pool_pipelined == pipeline.enabled) {
+        return download_pool;
+    }
+    if (download_pool != NULL) {
+        buf_pool_destroy(download_pool);     // Every buffer is back between downloads
+        download_pool = NULL;
+    }
+
+    size_t full = pipeline.enabled ? DOWNLOAD_POOL_BUFFERS_PSRAM : DOWNLOAD_POOL_BUFFERS_DIRECT;
+    buf_pool_config_t pool_config = { .buf_size = WRITE_SEGMENT_SIZE };
+    size_t free_bytes = heap_caps_get_free_size(MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (free_bytes >= full * WRITE_SEGMENT_SIZE) {
+        pool_config.region = BUF_POOL_REGION_PSRAM;
+        pool_config.max_buffers = full;
+    } else {
+        free_bytes = heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        size_t spare = free_bytes > DOWNLOAD_POOL_HEAP_RESERVE ? free_bytes - DOWNLOAD_POOL_HEAP_RESERVE : 0;
+        pool_config.region = BUF_POOL_REGION_INTERNAL;
+        pool_config.max_buffers = spare / WRITE_SEGMENT_SIZE;
+        if (pool_config.max_buffers > DOWNLOAD_POOL_BUFFERS_INTERNAL) {
+            pool_config.max_buffers = DOWNLOAD_POOL_BUFFERS_INTERNAL;
+        }
+        if (pool_config.max_buffers < WRITE_BUFFER_MIN / WRITE_SEGMENT_SIZE) {
+            ESP_LOGE(TAG, "❌ Only %u bytes of internal heap free", (unsigned)free_bytes);
+            return NULL;
+        }
+    }
+    ESP_LOGI(TAG, "🧮 Buffer pool: up to %u x %d bytes in %s", (unsigned)pool_config.max_buffers,
+             WRITE_SEGMENT_SIZE, pool_config.region == BUF_POOL_REGION_PSRAM ? "PSRAM" : "internal RAM");
+    download_pool = buf_pool_create(&pool_config);
+    download_pool_buffers = pool_config.max_buffers;
+    download_pool_pipelined = pipeline.enabled;
+    return download_pool;
+}
+
+// Run download_mirrors() as the network stage of the pipeline; falls back to
+// the plain in-task download if the tasks can't be created
+static esp_err_t download_pipelined(const char *const *urls, size_t url_count)
+{
+    writer_queue = xQueueCreate(PIPELINE_QUEUE_LEN, sizeof(write_job_t));
+    writer_idle = xSemaphoreCreateBinary();
+    net_job_t job = { urls, url_count, ESP_FAIL, xSemaphoreCreateBinary() };
+    TaskHandle_t writer = NULL;
+    if (writer_queue && writer_idle && job.done) {
+        xTaskCreatePinnedToCore(writer_task, "dl_writer", PIPELINE_WRITER_STACK, NULL,
+                                pipeline.writer_priority, &writer, pipeline_core(pipeline.writer_core));
+    }
+
+    pipeline_active = writer != NULL;
+    if (pipeline_active &&
+        xTaskCreatePinnedToCore(net_task, "dl_net", PIPELINE_NET_STACK, &job,
+                                pipeline.net_priority, NULL, pipeline_core(pipeline.net_core)) == pdPASS) {
+        xSemaphoreTake(job.done, portMAX_DELAY);
+    } else {
+        ESP_LOGW(TAG, "⚠️ Pipeline tasks unavailable, downloading in the caller's task");
+        pipeline_active = false;
+        job.ret = download_mirrors(urls, url_count);
+    }
+
+    if (writer) {
+        write_job_t exit_marker = { NULL, 1 };
+        xQueueSend(writer_queue, &exit_marker, portMAX_DELAY);
+        xSemaphoreTake(writer_idle, portMAX_DELAY);
+    }
+    stats.pipelined = pipeline_active;
+    pipeline_active = false;
+    if (job.done) {
+        vSemaphoreDelete(job.done);
+    }
+    if (writer_idle) {
+        vSemaphoreDelete(writer_idle);
+        writer_idle = NULL;
+    }
+    if (writer_queue) {
+        vQueueDelete(writer_queue);
+        writer_queue = NULL;
+    }
+    return job.ret;
+}
+
+esp_err_t https_download_to_sink(const char *const *urls, size_t url_count, const download_sink_t *out)
+{
+    if (out == NULL || out->write == NULL || out->reset == NULL ||
+        out->finish == NULL || out->abort == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    static stage_t sink_stage;
+    stage_init_sink(&sink_stage, out);
+    return https_download_to_stage(urls, url_count, &sink_stage);
+}
+
+esp_err_t https_download_to_stage(const char *const *urls, size_t url_count, stage_t *head)
+{
+    if (head == NULL || head->push == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    init_limiters();
+    stage_init_rate_limit(&flash_rate_stage, &flash_limiter, head);
+    stage_chain_reset_stats(&flash_rate_stage);
+
+    if (download_pool_get() == NULL) {
+        ESP_LOGE(TAG, "❌ Failed to create download buffer pool");
+        stage_abort(head);
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    flush_lat_us = 0;
+    flush_total_us = 0;
+    segment_count = 0;
+    // Leave the pipeline writer half of a small pool to hand segments back through
+    size_t initial_segments = WRITE_BUFFER_INITIAL / WRITE_SEGMENT_SIZE;
+    if (pipeline.enabled && initial_segments > download_pool_buffers / 2) {
+        initial_segments = download_pool_buffers / 2;
+    }
+    while (segment_count < initial_segments || segment_count < WRITE_BUFFER_MIN / WRITE_SEGMENT_SIZE) {
+        uint8_t *seg = buf_pool_acquire(download_pool, segment_count < WRITE_BUFFER_MIN / WRITE_SEGMENT_SIZE ?
+                                                       DOWNLOAD_POOL_WAIT_MS : 0);
+        if (seg == NULL) {
+            break;
+        }
+        write_segments[segment_count++] = seg;
+    }
+    if (segment_count < WRITE_BUFFER_MIN / WRITE_SEGMENT_SIZE) {
+        ESP_LOGE(TAG, "❌ No download buffer available");
+        while (segment_count > 0) {
+            buf_pool_release(download_pool, write_segments[--segment_count]);
+        }
+        stage_abort(head);
+        return ESP_ERR_NO_MEM;
+    }
+    stats.write_buffer_size = stats.write_buffer_peak = buffer_capacity();
+
+    flash_wear_stats_t wear_before, wear_after, wear;
+    flash_wear_get(&wear_before);
+    int64_t t0 = esp_timer_get_time();
+    chain = &flash_rate_stage;
+    writer_busy_us = 0;
+    net_stall_us = 0;
+    esp_err_t ret = pipeline.enabled ? download_pipelined(urls, url_count)
+                                     : download_mirrors(urls, url_count);
+    if (ret == ESP_OK) {
+        ret = stage_finish(chain);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "❌ Stage chain failed to finish (%s)", esp_err_to_name(ret));
+        } else {
+            metric_counter_add(&m_downloads, 1);
+        }
+    } else {
+        stage_abort(chain);
+    }
+    stage_chain_log(chain);
+    chain = NULL;
+
+    stats.bytes = total_bytes;
+    stats.elapsed_us = esp_timer_get_time() - t0;
+    stats.flush_avg_us = stats.flush_count ? (uint32_t)(flush_total_us / stats.flush_count) : 0;
+    if (stats.pipelined && stats.elapsed_us > 0) {
+        stats.net_stall_pct = (uint32_t)(net_stall_us * 100 / stats.elapsed_us);
+        stats.writer_busy_pct = (uint32_t)(writer_busy_us * 100 / stats.elapsed_us);
+    }
+    flash_wear_get(&wear_after);
+    flash_wear_diff(&wear_before, &wear_after, &wear);
+    stats.flash_pages_programmed = wear.pages_programmed;
+    stats.flash_sectors_erased = wear.sectors_erased;
+    flash_wear_report("download", &wear, total_bytes);
+    while (segment_count > 0) {
+        buf_pool_release(download_pool, write_segments[--segment_count]);
+    }
+
+    if (stats.reserved_bytes > 0) {
+        ESP_LOGI(TAG, "🧮 Reserved %u bytes up front in %u us",
+                 (unsigned)stats.reserved_bytes, (unsigned)stats.reserve_us);
+    } else if (stats.reserve_steps > 0) {
+        ESP_LOGI(TAG, "🧮 Reserved space in %u steps, %u us total",
+                 (unsigned)stats.reserve_steps, (unsigned)stats.reserve_us);
+    }
+    ESP_LOGI(TAG, "🧮 Write buffer: %u bytes (peak %u, %u grows, %u shrinks), "
+             "%u flushes avg %u us max %u us, net %u B/s",
+             (unsigned)stats.write_buffer_size, (unsigned)stats.write_buffer_peak,
+             (unsigned)stats.write_buffer_grows, (unsigned)stats.write_buffer_shrinks,
+             (unsigned)stats.flush_count, (unsigned)stats.flush_avg_us,
+             (unsigned)stats.flush_max_us, (unsigned)stats.net_rate_bps);
+
+#if FAULT_INJECT_ENABLED
+    if (fault_inject_fired() > 0) {
+        // Cost of the failures: bytes fetched twice and time from last fault to the end
+        ESP_LOGW(TAG, "💥 %u faults, %u attempts, %u bytes on the wire for %u stored, "
+                 "done %lld ms after the last fault",
+                 (unsigned)fault_inject_fired(), (unsigned)stats.attempts,
+                 (unsigned)stats.wire_bytes, (unsigned)stats.bytes,
+                 (esp_timer_get_time() - fault_inject_last_time_us()) / 1000);
+    }
+#endif
+
+    if (stats.pipelined) {
+        ESP_LOGI(TAG, "🧵 Pipeline: network on core %d stalled %u%%, writer on core %d busy %u%%",
+                 pipeline.net_core, (unsigned)stats.net_stall_pct,
+                 pipeline.writer_core, (unsigned)stats.writer_busy_pct);
+    }
+
+    buf_pool_stats_t pool_stats;
+    buf_pool_get_stats(download_pool, &pool_stats);
+    ESP_LOGI(TAG, "🧮 Buffer pool: %u/%u in use, high-water %u, %u waits",
+             pool_stats.in_use, pool_stats.allocated, pool_stats.high_water, (unsigned)pool_stats.waits);
+    return ret;
+}
+
+void https_get_last_stats(https_download_stats_t *out)
+{
+    *out = stats;
+}
+
+void https_set_rate_limits(uint32_t net_bps, uint32_t flash_bps)
+{
+    init_limiters();
+    rate_limiter_set_rate(&net_limiter, net_bps);
+    rate_limiter_set_rate(&flash_limiter, flash_bps);
+    ESP_LOGI(TAG, "🚦 Rate limits: network %u B/s, flash %u B/s (0 = unlimited)",
+             (unsigned)net_bps, (unsigned)flash_bps);
+}
+
+void https_set_max_body_size(size_t max_bytes)
+{
+    max_body_bytes = max_bytes;
+}
+
+esp_err_t https_get_file_progress(const char *path, size_t *committed, uint32_t *generation)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    portENTER_CRITICAL(&file_progress_lock);
+    if (file_stage_ctx.active && strcmp(file_stage_ctx.path, path) == 0) {
+        *committed = file_stage_ctx.committed;
+        *generation = file_stage_ctx.generation;
+        file_stage_ctx.followed = true;     // Sync every span from now on
+        ret = ESP_OK;
+    }
+    portEXIT_CRITICAL(&file_progress_lock);
+    return ret;
+}
 
-            // Exponential backoff before retry
-            int backoff_ms = BACKOFF_BASE_MS * (1 << (attempt - 1));
-            ESP_LOGW(TAG, "⏳ Retrying in %d ms...", backoff_ms);
-            vTaskDelay(pdMS_TO_TICKS(backoff_ms));
+esp_err_t https_watch_file(const char *path, https_file_watch_cb_t cb, void *ctx)
+{
+    SemaphoreHandle_t lock = file_watch_get_lock();
+    if (lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (size_t i = 0; i < FILE_WATCH_MAX; i++) {
+        if (file_watches[i].cb == NULL) {
+            file_watches[i] = (file_watch_t) { path, cb, ctx };
+            ret = ESP_OK;
+            break;
         }
+    }
+    xSemaphoreGive(lock);
+    return ret;
+}
 
-        esp_http_client_cleanup(client);
+void https_unwatch_file(https_file_watch_cb_t cb, void *ctx)
+{
+    SemaphoreHandle_t lock = file_watch_get_lock();
+    if (lock == NULL) {
+        return;
     }
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (size_t i = 0; i < FILE_WATCH_MAX; i++) {
+        if (file_watches[i].cb == cb && file_watches[i].ctx == ctx) {
+            file_watches[i].cb = NULL;
+        }
+    }
+    xSemaphoreGive(lock);
+}
+
+void https_set_encryption(const uint8_t *key)
+{
+    encrypt_files = key != NULL;
+    if (key) {
+        memcpy(encrypt_key, key, CRYPT_KEY_SIZE);
+    } else {
+        memset(encrypt_key, 0, CRYPT_KEY_SIZE);
+    }
+}
 
-    return ESP_FAIL;
+void https_set_pipeline(const https_pipeline_config_t *config)
+{
+    pipeline = *config;
+}
+
+void https_session_begin(void)
+{
+    session_active = true;
+}
+
+void https_session_end(void)
+{
+    session_active = false;
+    if (session_client) {
+        esp_http_client_cleanup(session_client);
+        session_client = NULL;
+    }
+}
+
+void https_set_pull_mode(bool enable)
+{
+    pull_mode = enable;
+}
+
+int64_t https_get_first_byte_time_us(void)
+{
+    return first_byte_time;
 }
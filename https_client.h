@@ -1,9 +1,134 @@
 #ifndef HTTPS_CLIENT_H
 #define HTTPS_CLIENT_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "esp_err.h"
 
+typedef struct {
+    size_t bytes;                   // Bytes committed to the destination file
+    size_t wire_bytes;              // Body bytes received over all attempts (>= bytes after retries)
+    uint32_t attempts;
+    int64_t elapsed_us;
+    uint32_t net_rate_bps;          // Receive rate the buffer sizing last used
+    uint32_t write_buffer_size;     // Write buffer size at the end of the download
+    uint32_t write_buffer_peak;
+    uint32_t write_buffer_grows;
+    uint32_t write_buffer_shrinks;
+    uint32_t flush_count;
+    uint32_t flush_avg_us;
+    uint32_t flush_max_us;
+    size_t reserved_bytes;          // Space reserved up front from Content-Length
+    uint32_t reserve_us;            // Time spent reserving (GC moved out of the transfer)
+    uint32_t reserve_steps;         // Incremental reservations for bodies without Content-Length
+    uint32_t flash_pages_programmed;  // Physical SPIFFS page programs during the download
+    uint32_t flash_sectors_erased;
+    bool pipelined;                 // Network and sink ran as separate pinned tasks
+    uint32_t net_stall_pct;         // Pipeline: share of the download the network waited on the writer
+    uint32_t writer_busy_pct;       // Pipeline: share of the download the writer spent in the sink
+} https_download_stats_t;
+
+// Consumer of the downloaded byte stream. The download calls exactly one of
+// finish() (after a complete body) or abort(), after which the sink is done.
+// When pipelined, write() runs on the writer task and reserve() may be called
+// from the network task at the same time.
+typedef struct {
+    esp_err_t (*write)(void *ctx, const uint8_t *data, size_t len);
+    esp_err_t (*reset)(void *ctx);      // Server ignored Range: stream restarts at byte 0
+    esp_err_t (*reserve)(void *ctx, size_t bytes); // Optional: this many more bytes are coming
+    esp_err_t (*finish)(void *ctx);
+    void (*abort)(void *ctx);
+    void *ctx;
+} download_sink_t;
+
 // Initialize HTTPS and download file from given URL to SPIFFS
 esp_err_t https_download_file(const char *url, const char *dest_path);
 
-#endif // HTTPS_CLIENT_H
\ No newline at end of file
+// Same as https_download_file, but with a list of mirrors serving identical content.
+// Mirrors are ranked by remembered (NVS) or probed throughput, and a failed or
+// too-slow connection fails over to the next one, resuming at the committed offset.
+esp_err_t https_download_file_mirrors(const char *const *urls, size_t url_count, const char *dest_path);
+
+// Download into a custom sink (e.g. an archive extractor) instead of a plain file
+esp_err_t https_download_to_sink(const char *const *urls, size_t url_count, const download_sink_t *sink);
+
+// Download through a chain of transform stages (see stage.h); the chain's last
+// stage stores the data. The flash rate limit runs in front of `head`.
+struct stage;
+esp_err_t https_download_to_stage(const char *const *urls, size_t url_count, struct stage *head);
+
+// Throttle downloads so background transfers leave room for foreground traffic:
+// net_bps caps bytes read from the network, flash_bps bytes written to storage.
+// 0 = unlimited. Takes effect immediately, also for a download in progress, and
+// stays in force for later downloads until changed (set per job before starting it).
+void https_set_rate_limits(uint32_t net_bps, uint32_t flash_bps);
+
+// Refuse bodies larger than max_bytes (0 = no cap). A known Content-Length over the
+// cap fails before any byte is written; a chunked or close-delimited body is aborted
+// as soon as it crosses it. Either way the sink is aborted and the download returns
+// ESP_ERR_INVALID_SIZE without retrying.
+void https_set_max_body_size(size_t max_bytes);
+
+// Encrypt files written by https_download_file*() with this 32-byte AES-256 key
+// (see crypt_stage.h for the format and crypt_reader_* to read them back).
+// NULL turns encryption off again. The key is copied.
+void https_set_encryption(const uint8_t *key);
+
+// While https_download_file*() is writing `path`: bytes already readable from the
+// file and a generation that changes whenever a retry truncates it. Returns
+// ESP_ERR_NOT_FOUND when no download is writing that path.
+esp_err_t https_get_file_progress(const char *path, size_t *committed, uint32_t *generation);
+
+typedef enum {
+    HTTPS_FILE_STARTED,     // The file was (re)created empty: first attempt or a retry from zero
+    HTTPS_FILE_DATA,        // data/len were just committed at file offset `offset`
+    HTTPS_FILE_DONE,
+    HTTPS_FILE_FAILED,
+} https_file_event_t;
+
+// Runs in the task that writes the file (the pipeline writer, when pipelined)
+// and holds up the download while it runs: copy what you need and return.
+// Encrypted downloads pass the ciphertext as written.
+typedef void (*https_file_watch_cb_t)(void *ctx, https_file_event_t event,
+                                      const uint8_t *data, size_t len, size_t offset);
+
+// Get called for every change to `path` made by https_download_file*(). At most
+// FILE_WATCH_MAX watches; path must stay valid until unwatched. Once
+// https_unwatch_file() returns the callback is not running and won't be called.
+#define FILE_WATCH_MAX 4
+esp_err_t https_watch_file(const char *path, https_file_watch_cb_t cb, void *ctx);
+void https_unwatch_file(https_file_watch_cb_t cb, void *ctx);
+
+// Dual-core pipeline: the network task receives into the write buffer and hands
+// full segments to a writer task that runs the sink (hashing, decompression,
+// flash). Each is pinned to its own core; the defaults put the network on core 0
+// next to the Wi-Fi and lwIP tasks and the writer on core 1.
+typedef struct {
+    bool enabled;
+    int net_core;                   // Core id, or -1 for no affinity
+    unsigned net_priority;
+    int writer_core;
+    unsigned writer_priority;
+} https_pipeline_config_t;
+
+// Applies to downloads started afterwards
+void https_set_pipeline(const https_pipeline_config_t *config);
+
+// Between begin and end, downloads reuse one HTTP client and keep-alive
+// connection (per host) instead of a fresh TCP + TLS handshake each time
+void https_session_begin(void);
+void https_session_end(void);
+
+// Select the receive path: pull mode (default) reads the body straight into the
+// write buffer; event mode copies it out of the client's RX buffer in the event
+// handler. Both log their throughput so they can be compared on the same link.
+void https_set_pull_mode(bool enable);
+
+// Stats of the most recent download (complete or not)
+void https_get_last_stats(https_download_stats_t *stats);
+
+// esp_timer timestamp (us since boot) of the first payload byte received, 0 if none yet
+int64_t https_get_first_byte_time_us(void);
+
+#endif // HTTPS_CLIENT_H
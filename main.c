@@ -1,16 +1,92 @@
 #include <stdio.h>
+#include <string.h>
 #include <sys/stat.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/event_groups.h"
 #include "esp_log.h"
+#include "esp_crt_bundle.h"
+#include "lwip/netdb.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "spiffs.h"
 
 #include "wifi.h"
 #include "https_client.h"
+#include "metrics.h"
+#include "trace.h"
+#include "fault_inject.h"
+#include "flash_wear.h"
 
 static const char *TAG = "MAIN";
 
+#define NET_READY_TIMEOUT_MS  15000   // Give up waiting for IP + DNS after 15 sec
+#define BOOT_TASK_STACK       4096
+#define METRICS_SERVER_PORT   8080    // GET /metrics, 0 = don't serve
+#define METRICS_DUMP_PATH     "/spiffs/metrics.prom"
+#define TRACE_DUMP_PATH       "/spiffs/trace.bin"
+#define FAULT_SCRIPT_PATH     "/spiffs/faults.txt"  // Read in fault-injection builds
+#define FLASH_WEAR_BENCH      0       // 1 = run the SPIFFS wear workloads after the download
+
+// Parallel boot stages, joined in app_main
+#define BOOT_SPIFFS_OK_BIT    BIT0
+#define BOOT_SPIFFS_FAIL_BIT  BIT1
+#define BOOT_TLS_DONE_BIT     BIT2
+#define BOOT_DNS_DONE_BIT     BIT3
+
+static EventGroupHandle_t boot_event_group;
+
+// File download
+static const char *url = "https://jumpshare.com/s/qjrb7NvwsWr9DjREgHYK";
+static const char *filepath = "/spiffs/sample.txt";
+
+static void spiffs_mount_task(void *arg)
+{
+    if (spiffs_init() == ESP_OK) {
+        xEventGroupSetBits(boot_event_group, BOOT_SPIFFS_OK_BIT);
+    } else {
+        xEventGroupSetBits(boot_event_group, BOOT_SPIFFS_FAIL_BIT);
+    }
+    vTaskDelete(NULL);
+}
+
+static void tls_prepare_task(void *arg)
+{
+    // Parses the embedded certificate bundle once so the first handshake doesn't pay for it
+    if (esp_crt_bundle_attach(NULL) != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️ Certificate bundle preload failed");
+    }
+    xEventGroupSetBits(boot_event_group, BOOT_TLS_DONE_BIT);
+    vTaskDelete(NULL);
+}
+
+static void dns_prepare_task(void *arg)
+{
+    // Extract host from "scheme://host[:port]/path"
+    char host[128] = {0};
+    const char *start = strstr(url, "://");
+    start = start ? start + 3 : url;
+    size_t len = strcspn(start, ":/?");
+    if (len > 0 && len < sizeof(host)) {
+        memcpy(host, start, len);
+
+        if (wifi_wait_ready(WIFI_DNS_READY_BIT, NET_READY_TIMEOUT_MS) == ESP_OK) {
+            // lwIP caches the answer, so the HTTP client's own lookup is then instant
+            struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+            struct addrinfo *res = NULL;
+            int err = getaddrinfo(host, NULL, &hints, &res);
+            if (err == 0 && res) {
+                ESP_LOGI(TAG, "✅ Pre-resolved %s", host);
+                freeaddrinfo(res);
+            } else {
+                ESP_LOGW(TAG, "⚠️ DNS pre-resolution of %s failed (%d)", host, err);
+            }
+        }
+    }
+    xEventGroupSetBits(boot_event_group, BOOT_DNS_DONE_BIT);
+    vTaskDelete(NULL);
+}
+
 void app_main(void)
 {
     esp_err_t ret;
@@ -24,25 +100,45 @@ void app_main(void)
     ESP_ERROR_CHECK(ret);
     ESP_LOGI(TAG, "✅ NVS initialized");
 
-    // Init SPIFFS
-    if (spiffs_init() != ESP_OK) {
+    // 🚀 Kick off Wi-Fi association and let SPIFFS/TLS/DNS prep run alongside it
+    boot_event_group = xEventGroupCreate();
+    wifi_start_sta();
+    xTaskCreate(spiffs_mount_task, "spiffs_mount", BOOT_TASK_STACK, NULL, 5, NULL);
+    xTaskCreate(tls_prepare_task, "tls_prepare", BOOT_TASK_STACK, NULL, 5, NULL);
+    xTaskCreate(dns_prepare_task, "dns_prepare", BOOT_TASK_STACK, NULL, 5, NULL);
+
+    // Join: storage must be mounted, TLS and DNS prep finished (successfully or not)
+    EventBits_t bits = xEventGroupWaitBits(boot_event_group,
+                                           BOOT_SPIFFS_OK_BIT | BOOT_SPIFFS_FAIL_BIT,
+                                           pdFALSE, pdFALSE, portMAX_DELAY);
+    if (bits & BOOT_SPIFFS_FAIL_BIT) {
         ESP_LOGE(TAG, "❌ Failed to initialize SPIFFS");
         return;
     }
     ESP_LOGI(TAG, "✅ SPIFFS mounted successfully");
 
-    // Init Wi-Fi
-    wifi_init_sta();
-    ESP_LOGI(TAG, "✅ Wi-Fi initialization complete");
-
-    // Let Wi-Fi connect
-    vTaskDelay(pdMS_TO_TICKS(5000));
+    xEventGroupWaitBits(boot_event_group, BOOT_TLS_DONE_BIT | BOOT_DNS_DONE_BIT,
+                        pdFALSE, pdTRUE, portMAX_DELAY);
 
-    // File download
-    const char *url = "https://jumpshare.com/s/qjrb7NvwsWr9DjREgHYK";
-    const char *filepath = "/spiffs/sample.txt";
+    // Start as soon as the link can resolve the host, no fixed settle delay
+    if (wifi_wait_ready(WIFI_CONNECTED_BIT | WIFI_DNS_READY_BIT, NET_READY_TIMEOUT_MS) != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️ DNS not ready after %d ms, trying download anyway", NET_READY_TIMEOUT_MS);
+    }
+    ESP_LOGI(TAG, "✅ Wi-Fi initialization complete");
+    ESP_LOGI(TAG, "⏱️ Boot to network ready: %lld ms", wifi_get_ready_time_us() / 1000);
+    if (METRICS_SERVER_PORT) {
+        metrics_server_start(METRICS_SERVER_PORT);
+    }
 
+    if (FAULT_INJECT_ENABLED) {
+        fault_inject_load_file(FAULT_SCRIPT_PATH);
+    }
     ret = https_download_file(url, filepath);
+
+    int64_t first_byte_us = https_get_first_byte_time_us();
+    if (first_byte_us > 0) {
+        ESP_LOGI(TAG, "⏱️ Boot to first byte: %lld ms", first_byte_us / 1000);
+    }
     if (ret == ESP_OK) {
         struct stat st;
         if (stat(filepath, &st) == 0) {
@@ -54,6 +150,15 @@ void app_main(void)
     } else {
         ESP_LOGE(TAG, "❌ File download failed");
     }
+    if (metrics_dump(METRICS_DUMP_PATH) != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️ Failed to write metrics to %s", METRICS_DUMP_PATH);
+    }
+    if (TRACE_ENABLED) {
+        trace_dump(TRACE_DUMP_PATH);
+    }
+    if (FLASH_WEAR_BENCH) {
+        flash_wear_benchmark("/spiffs");
+    }
 
     // Keep app alive
     while (1) {
@@ -0,0 +1,413 @@
+#include "manifest_sync.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "https_client.h"
+#include "hash_sink.h"
+
+static const char *TAG = "SYNC";
+
+#define SYNC_MAX_FILES      64
+#define SYNC_PATH_MAX       48          // Relative path in the manifest
+#define SYNC_FULL_PATH_MAX  96
+#define SYNC_URL_MAX        256
+#define SYNC_MANIFEST_MAX   8192        // Manifest is small; held in RAM
+#define SYNC_STATE_FILE     ".manifest"
+#define SYNC_JOURNAL_FILE   ".manifest.new"
+#define SYNC_JOURNAL_TMP    ".manifest.tmp"
+#define SYNC_STAGED_TAG     "#staged "      // Journal line naming an entry to move into place
+#define SYNC_END_TAG        "#end "         // Last journal line, with the entry count
+
+typedef struct {
+    char path[SYNC_PATH_MAX];
+    uint32_t size;
+    uint8_t digest[HASH_SINK_DIGEST_LEN];
+    bool staged;                        // Downloaded to its staging file this sync
+} sync_entry_t;
+
+typedef struct {
+    sync_entry_t entries[SYNC_MAX_FILES];
+    size_t count;
+} sync_manifest_t;
+
+// ---- RAM sink for the manifest itself ----
+
+typedef struct {
+    char *buf;
+    size_t len;
+} ram_sink_ctx_t;
+
+static esp_err_t ram_sink_write(void *ctx, const uint8_t *data, size_t len)
+{
+    ram_sink_ctx_t *rs = ctx;
+    if (rs->len + len >= SYNC_MANIFEST_MAX) {
+        ESP_LOGE(TAG, "❌ Manifest larger than %d bytes", SYNC_MANIFEST_MAX);
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(rs->buf + rs->len, data, len);
+    rs->len += len;
+    return ESP_OK;
+}
+
+static esp_err_t ram_sink_reset(void *ctx)
+{
+    ((ram_sink_ctx_t *)ctx)->len = 0;
+    return ESP_OK;
+}
+
+static esp_err_t ram_sink_finish(void *ctx)
+{
+    ram_sink_ctx_t *rs = ctx;
+    rs->buf[rs->len] = '\0';
+    return ESP_OK;
+}
+
+static void ram_sink_abort(void *ctx)
+{
+}
+
+// ---- Manifest parsing ----
+
+static bool parse_hex(const char *in, uint8_t *out, size_t len)
+{
+    for (size_t i = 0; i < 2 * len; i++) {
+        char c = in[i];
+        int v = (c >= '0' && c <= '9') ? c - '0' :
+                (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+                (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+        if (v < 0) {
+            return false;
+        }
+        out[i / 2] = (i % 2) ? (out[i / 2] | v) : (uint8_t)(v << 4);
+    }
+    return true;
+}
+
+// Parses `text` in place; bad lines are rejected rather than skipped so a
+// corrupt manifest can never cause mass deletion. Staged markers are only
+// honoured in our own files (journal, state), never in a fetched manifest.
+// `ended` (our files only) reports whether the end marker was seen.
+static esp_err_t parse_manifest(char *text, sync_manifest_t *m, bool journal, bool *ended)
+{
+    m->count = 0;
+    if (ended) {
+        *ended = false;
+    }
+    char *save = NULL;
+    for (char *line = strtok_r(text, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        line[strcspn(line, "\r")] = '\0';
+        if (journal && ended && *ended && line[0] != '\0') {
+            ESP_LOGE(TAG, "❌ Journal continues past its end marker");
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (journal && strncmp(line, SYNC_END_TAG, strlen(SYNC_END_TAG)) == 0) {
+            char *end;
+            unsigned long n = strtoul(line + strlen(SYNC_END_TAG), &end, 10);
+            if (*end != '\0' || n != m->count) {
+                ESP_LOGE(TAG, "❌ Bad journal end marker: %s", line);
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            if (ended) {
+                *ended = true;
+            }
+            continue;
+        }
+        if (journal && strncmp(line, SYNC_STAGED_TAG, strlen(SYNC_STAGED_TAG)) == 0) {
+            // Only written to the journal, after all entries
+            char *end;
+            unsigned long i = strtoul(line + strlen(SYNC_STAGED_TAG), &end, 10);
+            if (*end != '\0' || i >= m->count) {
+                ESP_LOGE(TAG, "❌ Bad journal line: %s", line);
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            m->entries[i].staged = true;
+            continue;
+        }
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+        if (m->count == SYNC_MAX_FILES) {
+            ESP_LOGE(TAG, "❌ More than %d files in manifest", SYNC_MAX_FILES);
+            return ESP_ERR_NO_MEM;
+        }
+
+        sync_entry_t *e = &m->entries[m->count];
+        char *size_str = strchr(line, ' ');
+        char *path = size_str ? strchr(size_str + 1, ' ') : NULL;
+        if (!size_str || size_str - line != 2 * HASH_SINK_DIGEST_LEN || !path ||
+            !parse_hex(line, e->digest, HASH_SINK_DIGEST_LEN)) {
+            ESP_LOGE(TAG, "❌ Bad manifest line: %s", line);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        e->size = strtoul(size_str + 1, NULL, 10);
+        path++;
+        if (strlen(path) >= SYNC_PATH_MAX || strstr(path, "..") || path[0] == '/' || path[0] == '.') {
+            ESP_LOGE(TAG, "❌ Bad manifest path: %s", path);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        strcpy(e->path, path);
+        e->staged = false;
+        m->count++;
+    }
+    return ESP_OK;
+}
+
+// Our own copy of a manifest: only the parsed entries, so nothing the server sent
+// beyond them (comments, '#staged' lines) ever reaches the journal
+static bool write_manifest(FILE *f, const sync_manifest_t *m)
+{
+    for (size_t i = 0; i < m->count; i++) {
+        const sync_entry_t *e = &m->entries[i];
+        for (size_t j = 0; j < HASH_SINK_DIGEST_LEN; j++) {
+            if (fprintf(f, "%02x", e->digest[j]) != 2) {
+                return false;
+            }
+        }
+        if (fprintf(f, " %u %s\n", (unsigned)e->size, e->path) < 0) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < m->count; i++) {
+        if (m->entries[i].staged && fprintf(f, SYNC_STAGED_TAG "%u\n", (unsigned)i) < 0) {
+            return false;
+        }
+    }
+    return fprintf(f, SYNC_END_TAG "%u\n", (unsigned)m->count) > 0;
+}
+
+// need_end: reject a file cut short before its end marker (state files written
+// before the marker existed don't have one)
+static esp_err_t load_manifest_file(const char *path, sync_manifest_t *m, char *scratch, bool need_end)
+{
+    m->count = 0;
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    size_t len = fread(scratch, 1, SYNC_MANIFEST_MAX - 1, f);
+    fclose(f);
+    scratch[len] = '\0';
+    bool ended;
+    esp_err_t err = parse_manifest(scratch, m, true, &ended);
+    if (err == ESP_OK && need_end && !ended) {
+        ESP_LOGE(TAG, "❌ %s has no end marker, ignoring it", path);
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    if (err != ESP_OK) {
+        m->count = 0;
+    }
+    return err;
+}
+
+static const sync_entry_t *find_entry(const sync_manifest_t *m, const char *path)
+{
+    for (size_t i = 0; i < m->count; i++) {
+        if (strcmp(m->entries[i].path, path) == 0) {
+            return &m->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void full_path(const char *dir, const char *rel, char *out)
+{
+    snprintf(out, SYNC_FULL_PATH_MAX, "%s/%s", dir, rel);
+}
+
+// Staging name for entry i of the new manifest; deterministic so recovery can find it
+static void staging_path(const char *dir, size_t i, char *out)
+{
+    snprintf(out, SYNC_FULL_PATH_MAX, "%s/.n%u", dir, (unsigned)i);
+}
+
+// Staging files left by a sync that failed before journaling would otherwise be
+// mistaken for fresh downloads later
+static void remove_staging(const char *dir)
+{
+    char path[SYNC_FULL_PATH_MAX];
+    for (size_t i = 0; i < SYNC_MAX_FILES; i++) {
+        staging_path(dir, i, path);
+        unlink(path);
+    }
+}
+
+// Apply a journaled manifest: move the entries it marks as staged into place,
+// drop obsolete ones, then make the journal the current state. Safe to repeat
+// after a crash.
+static esp_err_t apply_commit(const char *dir, const sync_manifest_t *old_m,
+                              const sync_manifest_t *new_m, manifest_sync_stats_t *stats)
+{
+    char from[SYNC_FULL_PATH_MAX], to[SYNC_FULL_PATH_MAX];
+
+    for (size_t i = 0; i < new_m->count; i++) {
+        if (!new_m->entries[i].staged) {
+            continue;                   // Unchanged
+        }
+        staging_path(dir, i, from);
+        if (access(from, F_OK) != 0) {
+            continue;                   // Already moved before a reset
+        }
+        full_path(dir, new_m->entries[i].path, to);
+        unlink(to);                     // SPIFFS rename won't replace
+        if (rename(from, to) != 0) {
+            ESP_LOGE(TAG, "❌ Failed to move %s into place", to);
+            return ESP_FAIL;
+        }
+    }
+
+    for (size_t i = 0; i < old_m->count; i++) {
+        if (!find_entry(new_m, old_m->entries[i].path)) {
+            full_path(dir, old_m->entries[i].path, to);
+            if (unlink(to) == 0 && stats) {
+                stats->files_deleted++;
+            }
+        }
+    }
+
+    full_path(dir, SYNC_JOURNAL_FILE, from);
+    full_path(dir, SYNC_STATE_FILE, to);
+    unlink(to);
+    return rename(from, to) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+static bool file_matches(const char *dir, const sync_entry_t *e)
+{
+    char path[SYNC_FULL_PATH_MAX];
+    struct stat st;
+    full_path(dir, e->path, path);
+    return stat(path, &st) == 0 && (uint32_t)st.st_size == e->size;
+}
+
+esp_err_t manifest_sync(const char *manifest_url, const char *base_url,
+                        const char *dest_dir, manifest_sync_stats_t *stats)
+{
+    manifest_sync_stats_t local_stats = {0};
+    if (stats == NULL) {
+        stats = &local_stats;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    sync_manifest_t *old_m = malloc(sizeof(*old_m));
+    sync_manifest_t *new_m = malloc(sizeof(*new_m));
+    char *text = malloc(SYNC_MANIFEST_MAX);
+    char *url = malloc(SYNC_URL_MAX);
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    if (!old_m || !new_m || !text || !url) {
+        goto out;
+    }
+
+    char state_path[SYNC_FULL_PATH_MAX], journal_path[SYNC_FULL_PATH_MAX];
+    char journal_tmp[SYNC_FULL_PATH_MAX];
+    full_path(dest_dir, SYNC_STATE_FILE, state_path);
+    full_path(dest_dir, SYNC_JOURNAL_FILE, journal_path);
+    full_path(dest_dir, SYNC_JOURNAL_TMP, journal_tmp);
+
+    load_manifest_file(state_path, old_m, text, false);
+    unlink(journal_tmp);                // A journal that was never completed
+
+    // Finish a commit that was interrupted by a reset
+    if (load_manifest_file(journal_path, new_m, text, true) == ESP_OK) {
+        ESP_LOGW(TAG, "⚠️ Completing interrupted commit");
+        ret = apply_commit(dest_dir, old_m, new_m, NULL);
+        if (ret != ESP_OK) {
+            goto out;
+        }
+        *old_m = *new_m;
+    }
+    remove_staging(dest_dir);
+
+    https_session_begin();
+
+    // Fetch the manifest into RAM
+    ram_sink_ctx_t rs = { .buf = text };
+    download_sink_t ram_sink = {
+        .write = ram_sink_write,
+        .reset = ram_sink_reset,
+        .finish = ram_sink_finish,
+        .abort = ram_sink_abort,
+        .ctx = &rs,
+    };
+    ret = https_download_to_sink(&manifest_url, 1, &ram_sink);
+    if (ret != ESP_OK) {
+        goto out_session;
+    }
+    ret = parse_manifest(text, new_m, false, NULL);
+    if (ret != ESP_OK) {
+        goto out_session;
+    }
+    stats->files_total = new_m->count;
+
+    // Stage only new or changed files
+    for (size_t i = 0; i < new_m->count; i++) {
+        const sync_entry_t *e = &new_m->entries[i];
+        const sync_entry_t *prev = find_entry(old_m, e->path);
+        if (prev && memcmp(prev->digest, e->digest, HASH_SINK_DIGEST_LEN) == 0 &&
+            prev->size == e->size && file_matches(dest_dir, e)) {
+            stats->files_unchanged++;
+            stats->bytes_saved += e->size;
+            continue;
+        }
+
+        char stage[SYNC_FULL_PATH_MAX];
+        staging_path(dest_dir, i, stage);
+        snprintf(url, SYNC_URL_MAX, "%s/%s", base_url, e->path);
+
+        hash_sink_ctx_t hs;
+        download_sink_t sink;
+        ret = hash_sink_init(&sink, &hs, stage);
+        if (ret == ESP_OK) {
+            ret = https_download_to_sink((const char *const *)&url, 1, &sink);
+        }
+        if (ret == ESP_OK && (hs.bytes != e->size ||
+                              memcmp(hs.digest, e->digest, HASH_SINK_DIGEST_LEN) != 0)) {
+            ESP_LOGE(TAG, "❌ %s does not match manifest", e->path);
+            ret = ESP_ERR_INVALID_CRC;
+        }
+        if (ret != ESP_OK) {
+            // Leave the current set untouched
+            remove_staging(dest_dir);
+            goto out_session;
+        }
+        new_m->entries[i].staged = true;
+        stats->files_downloaded++;
+        stats->bytes_downloaded += e->size;
+    }
+
+    // Journal the new set, then commit it. The journal only appears under its
+    // real name once it is complete and on flash, so recovery never sees half of it
+    bool journaled = false;
+    FILE *f = fopen(journal_tmp, "w");
+    if (f) {
+        journaled = write_manifest(f, new_m) && fflush(f) == 0 && fsync(fileno(f)) == 0;
+        journaled = (fclose(f) == 0) && journaled;
+    }
+    unlink(journal_path);               // SPIFFS rename won't replace
+    journaled = journaled && rename(journal_tmp, journal_path) == 0;
+    if (!journaled) {
+        ESP_LOGE(TAG, "❌ Failed to write commit journal");
+        unlink(journal_tmp);
+        unlink(journal_path);
+        remove_staging(dest_dir);
+        ret = ESP_FAIL;
+        goto out_session;
+    }
+    ret = apply_commit(dest_dir, old_m, new_m, stats);
+
+    ESP_LOGI(TAG, "✅ Sync: %u files, %u downloaded, %u unchanged, %u deleted, "
+             "%llu bytes fetched, %llu bytes saved",
+             (unsigned)stats->files_total, (unsigned)stats->files_downloaded,
+             (unsigned)stats->files_unchanged, (unsigned)stats->files_deleted,
+             (unsigned long long)stats->bytes_downloaded, (unsigned long long)stats->bytes_saved);
+
+out_session:
+    https_session_end();
+out:
+    free(old_m);
+    free(new_m);
+    free(text);
+    free(url);
+    return ret;
+}
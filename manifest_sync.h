@@ -0,0 +1,35 @@
+#ifndef MANIFEST_SYNC_H
+#define MANIFEST_SYNC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t files_total;       // Entries in the new manifest
+    uint32_t files_downloaded;
+    uint32_t files_unchanged;
+    uint32_t files_deleted;
+    uint64_t bytes_downloaded;
+    uint64_t bytes_saved;       // Versus downloading every file again
+} manifest_sync_stats_t;
+
+// Bring dest_dir in line with the manifest at manifest_url.
+// Manifest format, one file per line ('#' starts a comment):
+//     <sha256 hex> <size> <relative path>
+// Files are fetched from base_url/<relative path> over one reused connection,
+// verified by size and digest, and only then committed together: the new
+// manifest is journaled, files renamed into place, obsolete ones deleted.
+// An interrupted commit is completed by the next call.
+esp_err_t manifest_sync(const char *manifest_url, const char *base_url,
+                        const char *dest_dir, manifest_sync_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MANIFEST_SYNC_H
@@ -0,0 +1,224 @@
+#include "metrics.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_http_server.h"
+
+static const char *TAG = "METRICS";
+
+#define METRICS_EXPORT_MAX   8192           // Text export buffer for dump and /metrics
+
+static const uint32_t bucket_bounds[METRIC_HIST_BUCKETS] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+    100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000,
+};
+
+static portMUX_TYPE registry_lock = portMUX_INITIALIZER_UNLOCKED;
+static metric_t *registry = NULL;
+static httpd_handle_t server = NULL;
+
+void metrics_register(metric_t *m)
+{
+    portENTER_CRITICAL(&registry_lock);
+    if (!m->registered) {
+        m->next = registry;
+        __atomic_store_n(&registry, m, __ATOMIC_RELEASE);
+        m->registered = true;
+    }
+    portEXIT_CRITICAL(&registry_lock);
+}
+
+void metric_counter_add(metric_t *m, uint32_t n)
+{
+    if (!m->registered) {
+        metrics_register(m);
+    }
+    __atomic_fetch_add(&m->counter[xPortGetCoreID()], n, __ATOMIC_RELAXED);
+}
+
+void metric_gauge_set(metric_t *m, int32_t value)
+{
+    if (!m->registered) {
+        metrics_register(m);
+    }
+    __atomic_store_n(&m->gauge, value, __ATOMIC_RELAXED);
+}
+
+void metric_gauge_add(metric_t *m, int32_t delta)
+{
+    if (!m->registered) {
+        metrics_register(m);
+    }
+    __atomic_fetch_add(&m->gauge, delta, __ATOMIC_RELAXED);
+}
+
+void metric_histogram_observe(metric_t *m, uint32_t value_us)
+{
+    if (!m->registered) {
+        metrics_register(m);
+    }
+    size_t b = 0;
+    while (b < METRIC_HIST_BUCKETS && value_us > bucket_bounds[b]) {
+        b++;
+    }
+    int core = xPortGetCoreID();
+    __atomic_fetch_add(&m->hist.buckets[core][b], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&m->hist.sum[core], value_us, __ATOMIC_RELAXED);
+}
+
+static void metric_read(const metric_t *m, metric_snapshot_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->name = m->name;
+    out->help = m->help;
+    out->type = m->type;
+    switch (m->type) {
+        case METRIC_TYPE_COUNTER:
+            for (int core = 0; core < portNUM_PROCESSORS; core++) {
+                out->value += __atomic_load_n(&m->counter[core], __ATOMIC_RELAXED);
+            }
+            break;
+
+        case METRIC_TYPE_GAUGE:
+            out->value = __atomic_load_n(&m->gauge, __ATOMIC_RELAXED);
+            break;
+
+        case METRIC_TYPE_HISTOGRAM:
+            for (int core = 0; core < portNUM_PROCESSORS; core++) {
+                for (size_t b = 0; b <= METRIC_HIST_BUCKETS; b++) {
+                    uint32_t n = __atomic_load_n(&m->hist.buckets[core][b], __ATOMIC_RELAXED);
+                    out->buckets[b] += n;
+                    out->count += n;
+                }
+                out->sum += __atomic_load_n(&m->hist.sum[core], __ATOMIC_RELAXED);
+            }
+            break;
+    }
+}
+
+size_t metrics_snapshot(metric_snapshot_t *out, size_t max)
+{
+    size_t n = 0;
+    // Metrics are only ever prepended, so walking from a stale head is safe
+    for (metric_t *m = __atomic_load_n(&registry, __ATOMIC_ACQUIRE); m; m = m->next, n++) {
+        if (n < max) {
+            metric_read(m, &out[n]);
+        }
+    }
+    return n;
+}
+
+// snprintf into buf at *used, tracking the full length even once buf is full
+static void append(char *buf, size_t len, size_t *used, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static void append(char *buf, size_t len, size_t *used, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(*used < len ? buf + *used : NULL, *used < len ? len - *used : 0, fmt, ap);
+    va_end(ap);
+    if (n > 0) {
+        *used += n;
+    }
+}
+
+size_t metrics_export_text(char *buf, size_t len)
+{
+    static const char *type_names[] = { "counter", "gauge", "histogram" };
+    size_t used = 0;
+    if (len > 0) {
+        buf[0] = '\0';
+    }
+
+    for (metric_t *m = __atomic_load_n(&registry, __ATOMIC_ACQUIRE); m; m = m->next) {
+        metric_snapshot_t s;
+        metric_read(m, &s);
+        append(buf, len, &used, "# HELP %s %s\n# TYPE %s %s\n",
+               s.name, s.help, s.name, type_names[s.type]);
+        if (s.type != METRIC_TYPE_HISTOGRAM) {
+            append(buf, len, &used, "%s %lld\n", s.name, s.value);
+            continue;
+        }
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b < METRIC_HIST_BUCKETS; b++) {
+            cumulative += s.buckets[b];
+            append(buf, len, &used, "%s_bucket{le=\"%u\"} %llu\n",
+                   s.name, (unsigned)bucket_bounds[b], cumulative);
+        }
+        append(buf, len, &used, "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %llu\n%s_count %llu\n",
+               s.name, s.count, s.name, s.sum, s.name, s.count);
+    }
+    return used;
+}
+
+esp_err_t metrics_dump(const char *path)
+{
+    char *text = malloc(METRICS_EXPORT_MAX);
+    if (text == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    size_t len = metrics_export_text(text, METRICS_EXPORT_MAX);
+    if (len >= METRICS_EXPORT_MAX) {
+        ESP_LOGW(TAG, "⚠️ Export truncated to %d bytes", METRICS_EXPORT_MAX - 1);
+        len = METRICS_EXPORT_MAX - 1;
+    }
+
+    esp_err_t ret = ESP_OK;
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        ESP_LOGE(TAG, "❌ Failed to open %s", path);
+        ret = ESP_FAIL;
+    } else {
+        if (fwrite(text, 1, len, f) != len) {
+            ret = ESP_FAIL;
+        }
+        if (fclose(f) != 0) {
+            ret = ESP_FAIL;
+        }
+    }
+    free(text);
+    return ret;
+}
+
+static esp_err_t metrics_get_handler(httpd_req_t *req)
+{
+    char *text = malloc(METRICS_EXPORT_MAX);
+    if (text == NULL) {
+        return httpd_resp_send_500(req);
+    }
+    size_t len = metrics_export_text(text, METRICS_EXPORT_MAX);
+    if (len >= METRICS_EXPORT_MAX) {
+        len = METRICS_EXPORT_MAX - 1;
+    }
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    esp_err_t ret = httpd_resp_send(req, text, len);
+    free(text);
+    return ret;
+}
+
+esp_err_t metrics_server_start(uint16_t port)
+{
+    if (server != NULL) {
+        return ESP_OK;
+    }
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = port;
+    config.ctrl_port = port + 1;
+    esp_err_t ret = httpd_start(&server, &config);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "❌ Failed to start metrics server (%s)", esp_err_to_name(ret));
+        return ret;
+    }
+
+    httpd_uri_t uri = {
+        .uri = "/metrics",
+        .method = HTTP_GET,
+        .handler = metrics_get_handler,
+    };
+    httpd_register_uri_handler(server, &uri);
+    ESP_LOGI(TAG, "📈 Serving metrics on port %u", port);
+    return ESP_OK;
+}
@@ -0,0 +1,80 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    METRIC_TYPE_COUNTER,
+    METRIC_TYPE_GAUGE,
+    METRIC_TYPE_HISTOGRAM,
+} metric_type_t;
+
+// Histograms share one set of latency buckets: 100 us .. 10 s, plus +Inf
+#define METRIC_HIST_BUCKETS 16
+
+// Updates are lock-free: every core bumps its own 32-bit slot atomically and
+// readers sum the slots. Counters wrap at 2^32 per core, which Prometheus
+// treats like a restart.
+typedef struct metric {
+    const char *name;
+    const char *help;
+    metric_type_t type;
+    bool registered;
+    struct metric *next;
+    union {
+        uint32_t counter[portNUM_PROCESSORS];
+        int32_t gauge;
+        struct {
+            uint32_t buckets[portNUM_PROCESSORS][METRIC_HIST_BUCKETS + 1];
+            uint32_t sum[portNUM_PROCESSORS];
+        } hist;
+    };
+} metric_t;
+
+// Define a metric in the module that updates it; it joins the registry on first update
+#define METRIC_DEFINE(var, metric_name, metric_type, metric_help) \
+    static metric_t var = { .name = metric_name, .help = metric_help, .type = metric_type }
+
+typedef struct {
+    const char *name;
+    const char *help;
+    metric_type_t type;
+    int64_t value;                              // Counter total or gauge value
+    uint64_t count;                             // Histogram observations
+    uint64_t sum;                               // Histogram sum of observed values
+    uint64_t buckets[METRIC_HIST_BUCKETS + 1];  // Per bucket, not cumulative
+} metric_snapshot_t;
+
+// Make a metric visible before its first update (exported as 0)
+void metrics_register(metric_t *m);
+
+void metric_counter_add(metric_t *m, uint32_t n);
+void metric_gauge_set(metric_t *m, int32_t value);
+void metric_gauge_add(metric_t *m, int32_t delta);
+void metric_histogram_observe(metric_t *m, uint32_t value_us);
+
+// Copy up to max metrics into out; returns how many are registered in total
+size_t metrics_snapshot(metric_snapshot_t *out, size_t max);
+
+// Prometheus text exposition format. Returns the length needed, like snprintf.
+size_t metrics_export_text(char *buf, size_t len);
+
+// Write the text export to a file, e.g. on SPIFFS
+esp_err_t metrics_dump(const char *path);
+
+// Serve the text export at http://<ip>:<port>/metrics
+esp_err_t metrics_server_start(uint16_t port);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // METRICS_H
@@ -0,0 +1,54 @@
+#include "rate_limit.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "trace.h"
+
+void rate_limiter_init(rate_limiter_t *rl, uint32_t rate_bps, uint32_t burst)
+{
+    portMUX_TYPE unlocked = portMUX_INITIALIZER_UNLOCKED;
+    rl->lock = unlocked;
+    rl->rate_bps = rate_bps;
+    rl->burst = burst;
+    rl->tokens = (int64_t)burst * 1000000;
+    rl->last_us = esp_timer_get_time();
+    rl->throttled_us = 0;
+}
+
+void rate_limiter_set_rate(rate_limiter_t *rl, uint32_t rate_bps)
+{
+    portENTER_CRITICAL(&rl->lock);
+    rl->rate_bps = rate_bps;
+    if (rate_bps == 0) {
+        rl->tokens = (int64_t)rl->burst * 1000000;     // Unlimited: forget any debt
+    }
+    portEXIT_CRITICAL(&rl->lock);
+}
+
+void rate_limiter_consume(rate_limiter_t *rl, size_t bytes)
+{
+    int64_t wait_us = 0;
+
+    portENTER_CRITICAL(&rl->lock);
+    int64_t now = esp_timer_get_time();
+    if (rl->rate_bps > 0) {
+        rl->tokens += (now - rl->last_us) * (int64_t)rl->rate_bps;
+        if (rl->tokens > (int64_t)rl->burst * 1000000) {
+            rl->tokens = (int64_t)rl->burst * 1000000;
+        }
+        rl->tokens -= (int64_t)bytes * 1000000;
+        if (rl->tokens < 0) {
+            wait_us = -rl->tokens / rl->rate_bps;
+        }
+    }
+    rl->last_us = now;
+    portEXIT_CRITICAL(&rl->lock);
+
+    if (wait_us > 0) {
+        // Round up so we never wake before the debt is paid
+        TickType_t ticks = (TickType_t)((wait_us + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000));
+        TRACE_BEGIN(TRACE_RATE_LIMIT, wait_us);
+        vTaskDelay(ticks);
+        TRACE_END(TRACE_RATE_LIMIT, wait_us);
+        rl->throttled_us += wait_us;
+    }
+}
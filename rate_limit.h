@@ -0,0 +1,35 @@
+#ifndef RATE_LIMIT_H
+#define RATE_LIMIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Token bucket. Consumers may overdraw; the debt is paid back by sleeping,
+// which keeps large writes simple and the average rate exact.
+typedef struct {
+    portMUX_TYPE lock;
+    uint32_t rate_bps;          // 0 = unlimited
+    uint32_t burst;             // Bucket depth in bytes
+    int64_t tokens;             // In micro-bytes, so slow refills don't round away
+    int64_t last_us;
+    uint64_t throttled_us;      // Total time spent sleeping
+} rate_limiter_t;
+
+void rate_limiter_init(rate_limiter_t *rl, uint32_t rate_bps, uint32_t burst);
+
+// Safe to call from another task while a transfer is consuming
+void rate_limiter_set_rate(rate_limiter_t *rl, uint32_t rate_bps);
+
+// Take `bytes` tokens, blocking the caller as long as the bucket is in debt
+void rate_limiter_consume(rate_limiter_t *rl, size_t bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RATE_LIMIT_H
@@ -3,16 +3,26 @@
 #include "esp_log.h"
 #include "esp_vfs.h"
 #include "esp_spiffs.h"
+#include "esp_timer.h"
+#include "metrics.h"
+#include "trace.h"
 
 static const char *TAG = "SPIFFS";
 
+METRIC_DEFINE(m_total, "spiffs_total_bytes", METRIC_TYPE_GAUGE, "Partition capacity");
+METRIC_DEFINE(m_used, "spiffs_used_bytes", METRIC_TYPE_GAUGE, "Bytes in use, as of the last check");
+METRIC_DEFINE(m_reserve_us, "spiffs_reserve_latency_us", METRIC_TYPE_HISTOGRAM,
+              "Free-space check plus GC ahead of a write");
+METRIC_DEFINE(m_no_space, "spiffs_out_of_space_total", METRIC_TYPE_COUNTER,
+              "Reservations refused for lack of space");
+
 esp_err_t spiffs_init(void)
 {
     ESP_LOGI(TAG, "Initializing SPIFFS...");
 
     esp_vfs_spiffs_conf_t conf = {
         .base_path = "/spiffs",
-        .partition_label = "spiffs",
+        .partition_label = SPIFFS_PARTITION_LABEL,
         .max_files = 5,
         .format_if_mount_failed = true
     };
@@ -33,7 +43,38 @@ esp_err_t spiffs_init(void)
     ret = esp_spiffs_info(conf.partition_label, &total, &used);
     if (ret == ESP_OK) {
         ESP_LOGI(TAG, "SPIFFS total: %d bytes, used: %d bytes", total, used);
+        metric_gauge_set(&m_total, (int32_t)total);
+        metric_gauge_set(&m_used, (int32_t)used);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t spiffs_reserve(size_t bytes)
+{
+    int64_t t0 = esp_timer_get_time();
+    size_t total = 0, used = 0;
+    TRACE_BEGIN(TRACE_SPIFFS_INFO, 0);
+    esp_err_t ret = esp_spiffs_info(SPIFFS_PARTITION_LABEL, &total, &used);
+    TRACE_END(TRACE_SPIFFS_INFO, 0);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    metric_gauge_set(&m_used, (int32_t)used);
+    if (total - used < bytes) {
+        ESP_LOGE(TAG, "Need %u bytes, only %u free", bytes, total - used);
+        metric_counter_add(&m_no_space, 1);
+        return ESP_ERR_NO_MEM;
     }
 
+    // SPIFFS has no fallocate; erasing the space we'll need now keeps
+    // GC stalls out of the transfer itself
+    TRACE_BEGIN(TRACE_SPIFFS_GC, bytes);
+    ret = esp_spiffs_gc(SPIFFS_PARTITION_LABEL, bytes);
+    TRACE_END(TRACE_SPIFFS_GC, bytes);
+    if (ret != ESP_OK && ret != ESP_ERR_NOT_FINISHED) {
+        ESP_LOGW(TAG, "GC before write failed (%s)", esp_err_to_name(ret));
+    }
+    metric_histogram_observe(&m_reserve_us, (uint32_t)(esp_timer_get_time() - t0));
     return ESP_OK;
 }
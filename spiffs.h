@@ -1,14 +1,21 @@
 #ifndef SPIFFS_H
 #define SPIFFS_H
 
+#include <stddef.h>
 #include "esp_err.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define SPIFFS_PARTITION_LABEL "spiffs"
+
 esp_err_t spiffs_init(void);
 
+// Make sure `bytes` can be written without hitting garbage collection mid-write:
+// fails with ESP_ERR_NO_MEM if they don't fit, otherwise runs GC up front.
+esp_err_t spiffs_reserve(size_t bytes);
+
 #ifdef __cplusplus
 }
 #endif
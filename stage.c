@@ -0,0 +1,156 @@
+#include "stage.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "STAGE";
+
+esp_err_t stage_push(stage_t *s, stage_span_t *span)
+{
+    if (s == NULL) {
+        stage_span_release(span);
+        return ESP_ERR_INVALID_STATE;
+    }
+    size_t len = span->len;
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = s->push(s, span);
+    s->push_us += esp_timer_get_time() - t0;
+    s->bytes_in += len;
+    return err;
+}
+
+esp_err_t stage_flush(stage_t *s)
+{
+    while (s && s->flush == NULL) {
+        s = s->next;
+    }
+    return s ? s->flush(s) : ESP_OK;
+}
+
+esp_err_t stage_finish(stage_t *s)
+{
+    while (s && s->finish == NULL) {
+        s = s->next;
+    }
+    return s ? s->finish(s) : ESP_OK;
+}
+
+void stage_abort(stage_t *s)
+{
+    while (s && s->abort == NULL) {
+        s = s->next;
+    }
+    if (s) {
+        s->abort(s);
+    }
+}
+
+esp_err_t stage_reset(stage_t *s)
+{
+    while (s && s->reset == NULL) {
+        s = s->next;
+    }
+    return s ? s->reset(s) : ESP_OK;
+}
+
+esp_err_t stage_reserve(stage_t *s, size_t bytes)
+{
+    while (s && s->reserve == NULL) {
+        s = s->next;
+    }
+    return s ? s->reserve(s, bytes) : ESP_ERR_NOT_SUPPORTED;
+}
+
+void stage_span_release(stage_span_t *span)
+{
+    if (span->release) {
+        span->release(span->owner, span->buf);
+        span->release = NULL;
+    }
+}
+
+void stage_chain_reset_stats(stage_t *head)
+{
+    for (stage_t *s = head; s; s = s->next) {
+        s->bytes_in = 0;
+        s->push_us = 0;
+    }
+}
+
+void stage_chain_log(const stage_t *head)
+{
+    for (const stage_t *s = head; s; s = s->next) {
+        // Downstream time is counted in our push too; report only our own share
+        uint64_t own_us = s->push_us;
+        if (s->next && s->next->push_us <= own_us) {
+            own_us -= s->next->push_us;
+        }
+        ESP_LOGI(TAG, "🔗 %-12s %llu bytes, %llu us (%.2f us/KB)",
+                 s->name ? s->name : "?", s->bytes_in, own_us,
+                 s->bytes_in ? own_us * 1024.0 / s->bytes_in : 0.0);
+    }
+}
+
+// ---- Adapter: download_sink_t as the terminal stage ----
+
+static esp_err_t sink_push(stage_t *s, stage_span_t *span)
+{
+    const download_sink_t *sink = s->ctx;
+    esp_err_t err = sink->write(sink->ctx, span->data, span->len);
+    stage_span_release(span);
+    return err;
+}
+
+static esp_err_t sink_finish(stage_t *s)
+{
+    const download_sink_t *sink = s->ctx;
+    return sink->finish(sink->ctx);
+}
+
+static void sink_abort(stage_t *s)
+{
+    const download_sink_t *sink = s->ctx;
+    sink->abort(sink->ctx);
+}
+
+static esp_err_t sink_reset(stage_t *s)
+{
+    const download_sink_t *sink = s->ctx;
+    return sink->reset(sink->ctx);
+}
+
+static esp_err_t sink_reserve(stage_t *s, size_t bytes)
+{
+    const download_sink_t *sink = s->ctx;
+    return sink->reserve ? sink->reserve(sink->ctx, bytes) : ESP_ERR_NOT_SUPPORTED;
+}
+
+void stage_init_sink(stage_t *s, const download_sink_t *sink)
+{
+    *s = (stage_t) {
+        .name = "sink",
+        .push = sink_push,
+        .finish = sink_finish,
+        .abort = sink_abort,
+        .reset = sink_reset,
+        .reserve = sink_reserve,
+        .ctx = (void *)sink,
+    };
+}
+
+// ---- Rate limit ----
+
+static esp_err_t rate_limit_push(stage_t *s, stage_span_t *span)
+{
+    rate_limiter_consume(s->ctx, span->len);
+    return stage_push(s->next, span);
+}
+
+void stage_init_rate_limit(stage_t *s, rate_limiter_t *limiter, stage_t *next)
+{
+    *s = (stage_t) {
+        .name = "rate_limit",
+        .push = rate_limit_push,
+        .next = next,
+        .ctx = limiter,
+    };
+}
@@ -0,0 +1,73 @@
+#ifndef STAGE_H
+#define STAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "rate_limit.h"
+#include "https_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A run of bytes moving down a stage chain. If release is set the span owns its
+// buffer: whoever ends up holding it (a queue, a later stage) must call
+// stage_span_release() once done, so buffers travel without copies. A span
+// without release is borrowed and only valid during the push. Either way the
+// pusher gives up the contents: a stage may transform data in place (encryption).
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    void (*release)(void *owner, uint8_t *buf);
+    void *owner;
+    uint8_t *buf;           // What release() gets back (data may point inside it)
+} stage_span_t;
+
+typedef struct stage stage_t;
+
+// One step of a streaming transform chain (decompress, decrypt, hash, extract,
+// throttle, store). push() is required; every other op is optional and, when
+// NULL, is passed on to the next stage. A stage that implements finish, abort
+// or reset must pass it on itself after handling its own state.
+struct stage {
+    const char *name;
+    esp_err_t (*push)(stage_t *s, stage_span_t *span);  // Always takes the span
+    esp_err_t (*flush)(stage_t *s);                     // Push out anything held back
+    esp_err_t (*finish)(stage_t *s);                    // The stream is complete
+    void (*abort)(stage_t *s);
+    esp_err_t (*reset)(stage_t *s);                     // The stream restarts at byte 0
+    esp_err_t (*reserve)(stage_t *s, size_t bytes);     // This many more bytes are coming
+    stage_t *next;
+    void *ctx;
+
+    uint64_t bytes_in;
+    uint64_t push_us;       // Time in push(), including the stages after it
+};
+
+esp_err_t stage_push(stage_t *s, stage_span_t *span);
+esp_err_t stage_flush(stage_t *s);
+esp_err_t stage_finish(stage_t *s);
+void stage_abort(stage_t *s);
+esp_err_t stage_reset(stage_t *s);
+
+// ESP_ERR_NOT_SUPPORTED if no stage in the chain can reserve
+esp_err_t stage_reserve(stage_t *s, size_t bytes);
+
+void stage_span_release(stage_span_t *span);
+
+// Per-stage bytes and own (exclusive) time, for tuning the chain
+void stage_chain_reset_stats(stage_t *head);
+void stage_chain_log(const stage_t *head);
+
+// Terminal stage that hands every span to a download_sink_t
+void stage_init_sink(stage_t *s, const download_sink_t *sink);
+
+// Pass-through stage that paces bytes with a token bucket
+void stage_init_rate_limit(stage_t *s, rate_limiter_t *limiter, stage_t *next);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STAGE_H
@@ -0,0 +1,431 @@
+#include "tar_sink.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "rom/miniz.h"
+#include "spiffs.h"
+
+static const char *TAG = "TAR_SINK";
+
+#define TAR_BLOCK_SIZE   512
+#define TAR_PATH_MAX     128
+
+// Gzip member header flags (RFC 1952)
+#define GZ_FHCRC         0x02
+#define GZ_FEXTRA        0x04
+#define GZ_FNAME         0x08
+#define GZ_FCOMMENT      0x10
+
+typedef enum {
+    TAR_HEADER,
+    TAR_DATA,
+    TAR_PADDING,
+    TAR_END,
+} tar_state_t;
+
+typedef enum {
+    GZ_FIXED,               // 10-byte fixed header
+    GZ_EXTRA_LEN,
+    GZ_EXTRA,
+    GZ_NAME,
+    GZ_COMMENT,
+    GZ_HCRC,
+    GZ_DEFLATE,
+    GZ_TRAILER,             // CRC32 + ISIZE, not verified
+} gz_state_t;
+
+typedef struct {
+    char dest_dir[TAR_PATH_MAX];
+
+    // ustar parser
+    tar_state_t state;
+    uint8_t header[TAR_BLOCK_SIZE];
+    size_t header_fill;
+    uint64_t remaining;             // Data bytes left in the current member
+    size_t padding;                 // Bytes up to the next block boundary
+    int zero_blocks;
+    FILE *member;                   // NULL while skipping a non-file entry
+    char member_path[TAR_PATH_MAX];
+    uint32_t members;
+    uint64_t bytes_written;
+
+    // Optional gzip layer
+    bool gunzip;
+    gz_state_t gz_state;
+    uint8_t gz_hdr[10];
+    size_t gz_fill;
+    size_t gz_skip;
+    bool gz_more_output;
+    tinfl_decompressor *inflator;
+    uint8_t *dict;                  // TINFL_LZ_DICT_SIZE circular output window
+    size_t dict_ofs;
+} tar_sink_ctx_t;
+
+static uint64_t parse_octal(const uint8_t *p, size_t n)
+{
+    uint64_t v = 0;
+    for (size_t i = 0; i < n && p[i]; i++) {
+        if (p[i] >= '0' && p[i] <= '7') {
+            v = (v << 3) | (p[i] - '0');
+        }
+    }
+    return v;
+}
+
+static bool block_is_zero(const uint8_t *b)
+{
+    for (size_t i = 0; i < TAR_BLOCK_SIZE; i++) {
+        if (b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void tar_close_member(tar_sink_ctx_t *t, bool complete)
+{
+    if (t->member) {
+        fclose(t->member);
+        t->member = NULL;
+        if (complete) {
+            t->members++;
+        } else {
+            unlink(t->member_path);     // Don't leave a truncated member behind
+        }
+    }
+}
+
+static esp_err_t tar_parse_header(tar_sink_ctx_t *t)
+{
+    const uint8_t *h = t->header;
+
+    if (block_is_zero(h)) {
+        // Two zero blocks mark the end of the archive
+        if (++t->zero_blocks == 2) {
+            t->state = TAR_END;
+        }
+        return ESP_OK;
+    }
+    t->zero_blocks = 0;
+
+    // Checksum is computed with its own field taken as spaces
+    uint32_t sum = 0;
+    for (size_t i = 0; i < TAR_BLOCK_SIZE; i++) {
+        sum += (i >= 148 && i < 156) ? ' ' : h[i];
+    }
+    if (sum != parse_octal(h + 148, 8)) {
+        ESP_LOGE(TAG, "❌ Bad tar header checksum");
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    uint64_t size = parse_octal(h + 124, 12);
+    char type = (char)h[156];
+    t->remaining = size;
+    t->padding = (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+    t->state = size ? TAR_DATA : TAR_HEADER;
+
+    if (type != '0' && type != '\0') {
+        return ESP_OK;                  // Not a regular file, skip its data
+    }
+
+    // name[100] at 0, ustar prefix[155] at 345
+    char name[101] = {0};
+    char prefix[156] = {0};
+    memcpy(name, h, 100);
+    if (memcmp(h + 257, "ustar", 5) == 0) {
+        memcpy(prefix, h + 345, 155);
+    }
+    const char *n = name;
+    while (n[0] == '.' && n[1] == '/') {
+        n += 2;
+    }
+    if (strstr(n, "..") || strstr(prefix, "..")) {
+        ESP_LOGW(TAG, "⚠️ Skipping unsafe member path %s", name);
+        return ESP_OK;
+    }
+
+    int len = prefix[0] ?
+              snprintf(t->member_path, sizeof(t->member_path), "%s/%s/%s", t->dest_dir, prefix, n) :
+              snprintf(t->member_path, sizeof(t->member_path), "%s/%s", t->dest_dir, n);
+    if (len < 0 || len >= (int)sizeof(t->member_path)) {
+        ESP_LOGE(TAG, "❌ Member path too long: %s", name);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    t->member = fopen(t->member_path, "wb");
+    if (!t->member) {
+        ESP_LOGE(TAG, "❌ Failed to create %s", t->member_path);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "📄 Extracting %s (%llu bytes)", t->member_path, (unsigned long long)size);
+    if (size == 0) {
+        tar_close_member(t, true);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t tar_feed(tar_sink_ctx_t *t, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        size_t n;
+        switch (t->state) {
+            case TAR_HEADER:
+                n = TAR_BLOCK_SIZE - t->header_fill;
+                n = (len < n) ? len : n;
+                memcpy(t->header + t->header_fill, data, n);
+                t->header_fill += n;
+                if (t->header_fill == TAR_BLOCK_SIZE) {
+                    t->header_fill = 0;
+                    esp_err_t err = tar_parse_header(t);
+                    if (err != ESP_OK) {
+                        return err;
+                    }
+                }
+                break;
+
+            case TAR_DATA:
+                n = (len < t->remaining) ? len : (size_t)t->remaining;
+                if (t->member) {
+                    if (fwrite(data, 1, n, t->member) != n) {
+                        ESP_LOGE(TAG, "❌ Write to %s failed", t->member_path);
+                        return ESP_FAIL;
+                    }
+                    t->bytes_written += n;
+                }
+                t->remaining -= n;
+                if (t->remaining == 0) {
+                    tar_close_member(t, true);
+                    t->state = t->padding ? TAR_PADDING : TAR_HEADER;
+                }
+                break;
+
+            case TAR_PADDING:
+                n = (len < t->padding) ? len : t->padding;
+                t->padding -= n;
+                if (t->padding == 0) {
+                    t->state = TAR_HEADER;
+                }
+                break;
+
+            case TAR_END:
+            default:
+                return ESP_OK;          // Trailing blocks after the end marker
+        }
+        data += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+// Next optional gzip header field present after `from`
+static gz_state_t gz_next_field(const tar_sink_ctx_t *t, gz_state_t from)
+{
+    uint8_t flags = t->gz_hdr[3];
+    if (from < GZ_EXTRA_LEN && (flags & GZ_FEXTRA)) {
+        return GZ_EXTRA_LEN;
+    }
+    if (from < GZ_NAME && (flags & GZ_FNAME)) {
+        return GZ_NAME;
+    }
+    if (from < GZ_COMMENT && (flags & GZ_FCOMMENT)) {
+        return GZ_COMMENT;
+    }
+    if (from < GZ_HCRC && (flags & GZ_FHCRC)) {
+        return GZ_HCRC;
+    }
+    return GZ_DEFLATE;
+}
+
+static esp_err_t gz_feed(tar_sink_ctx_t *t, const uint8_t *data, size_t len)
+{
+    while (len > 0 || t->gz_more_output) {
+        switch (t->gz_state) {
+            case GZ_FIXED:
+                t->gz_hdr[t->gz_fill++] = *data++;
+                len--;
+                if (t->gz_fill == sizeof(t->gz_hdr)) {
+                    if (t->gz_hdr[0] != 0x1f || t->gz_hdr[1] != 0x8b || t->gz_hdr[2] != 8) {
+                        ESP_LOGE(TAG, "❌ Not a gzip stream");
+                        return ESP_ERR_INVALID_RESPONSE;
+                    }
+                    t->gz_fill = 0;
+                    t->gz_state = gz_next_field(t, GZ_FIXED);
+                }
+                break;
+
+            case GZ_EXTRA_LEN:
+                t->gz_skip |= (size_t)(*data++) << (8 * t->gz_fill);
+                len--;
+                if (++t->gz_fill == 2) {
+                    t->gz_state = t->gz_skip ? GZ_EXTRA : gz_next_field(t, GZ_EXTRA);
+                }
+                break;
+
+            case GZ_EXTRA: {
+                size_t n = (len < t->gz_skip) ? len : t->gz_skip;
+                data += n;
+                len -= n;
+                t->gz_skip -= n;
+                if (t->gz_skip == 0) {
+                    t->gz_state = gz_next_field(t, GZ_EXTRA);
+                }
+                break;
+            }
+
+            case GZ_NAME:
+            case GZ_COMMENT:
+                len--;
+                if (*data++ == '\0') {
+                    t->gz_state = gz_next_field(t, t->gz_state);
+                }
+                break;
+
+            case GZ_HCRC:
+                data++;
+                len--;
+                if (++t->gz_skip == 2) {
+                    t->gz_state = GZ_DEFLATE;
+                }
+                break;
+
+            case GZ_DEFLATE: {
+                size_t in_bytes = len;
+                size_t out_bytes = TINFL_LZ_DICT_SIZE - t->dict_ofs;
+                tinfl_status status = tinfl_decompress(t->inflator, data, &in_bytes,
+                                                       t->dict, t->dict + t->dict_ofs, &out_bytes,
+                                                       TINFL_FLAG_HAS_MORE_INPUT);
+                data += in_bytes;
+                len -= in_bytes;
+                if (out_bytes > 0) {
+                    esp_err_t err = tar_feed(t, t->dict + t->dict_ofs, out_bytes);
+                    if (err != ESP_OK) {
+                        return err;
+                    }
+                    t->dict_ofs = (t->dict_ofs + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+                }
+                t->gz_more_output = (status == TINFL_STATUS_HAS_MORE_OUTPUT);
+                if (status == TINFL_STATUS_DONE) {
+                    t->gz_state = GZ_TRAILER;
+                } else if (status < 0) {
+                    ESP_LOGE(TAG, "❌ Inflate failed (%d)", (int)status);
+                    return ESP_ERR_INVALID_RESPONSE;
+                } else if (status == TINFL_STATUS_NEEDS_MORE_INPUT && len == 0) {
+                    return ESP_OK;
+                }
+                break;
+            }
+
+            case GZ_TRAILER:
+            default:
+                return ESP_OK;
+        }
+    }
+    return ESP_OK;
+}
+
+static void tar_sink_reset_state(tar_sink_ctx_t *t)
+{
+    tar_close_member(t, false);
+    t->state = TAR_HEADER;
+    t->header_fill = 0;
+    t->remaining = 0;
+    t->padding = 0;
+    t->zero_blocks = 0;
+    t->members = 0;
+    t->bytes_written = 0;
+
+    t->gz_state = GZ_FIXED;
+    t->gz_fill = 0;
+    t->gz_skip = 0;
+    t->gz_more_output = false;
+    t->dict_ofs = 0;
+    if (t->inflator) {
+        tinfl_init(t->inflator);
+    }
+}
+
+static void tar_sink_free(tar_sink_ctx_t *t)
+{
+    free(t->inflator);
+    free(t->dict);
+    free(t);
+}
+
+static esp_err_t tar_sink_write(void *ctx, const uint8_t *data, size_t len)
+{
+    tar_sink_ctx_t *t = ctx;
+    return t->gunzip ? gz_feed(t, data, len) : tar_feed(t, data, len);
+}
+
+static esp_err_t tar_sink_reset(void *ctx)
+{
+    tar_sink_reset_state(ctx);
+    return ESP_OK;
+}
+
+// Extracted size ~ archive size for a plain tar; unknown for .tar.gz
+static esp_err_t tar_sink_reserve(void *ctx, size_t bytes)
+{
+    tar_sink_ctx_t *t = ctx;
+    return t->gunzip ? ESP_ERR_NOT_SUPPORTED : spiffs_reserve(bytes);
+}
+
+static esp_err_t tar_sink_finish(void *ctx)
+{
+    tar_sink_ctx_t *t = ctx;
+    esp_err_t ret = ESP_OK;
+
+    // Archives without the zero-block trailer are accepted if they end on a member boundary
+    bool complete = (t->state == TAR_END || (t->state == TAR_HEADER && t->header_fill == 0)) &&
+                    (!t->gunzip || t->gz_state == GZ_TRAILER);
+    if (!complete) {
+        ESP_LOGE(TAG, "❌ Archive truncated");
+        ret = ESP_ERR_INVALID_SIZE;
+    } else {
+        ESP_LOGI(TAG, "✅ Extracted %u files, %llu bytes", (unsigned)t->members,
+                 (unsigned long long)t->bytes_written);
+    }
+    tar_close_member(t, complete);
+    tar_sink_free(t);
+    return ret;
+}
+
+static void tar_sink_abort(void *ctx)
+{
+    tar_sink_ctx_t *t = ctx;
+    tar_close_member(t, false);
+    tar_sink_free(t);
+}
+
+esp_err_t tar_sink_init(download_sink_t *sink, const char *dest_dir, bool gunzip)
+{
+    if (sink == NULL || dest_dir == NULL || strlen(dest_dir) >= TAR_PATH_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    tar_sink_ctx_t *t = calloc(1, sizeof(*t));
+    if (t == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    strcpy(t->dest_dir, dest_dir);
+    t->gunzip = gunzip;
+    if (gunzip) {
+        t->inflator = malloc(sizeof(tinfl_decompressor));
+        t->dict = malloc(TINFL_LZ_DICT_SIZE);
+        if (!t->inflator || !t->dict) {
+            tar_sink_free(t);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    tar_sink_reset_state(t);
+
+    sink->write = tar_sink_write;
+    sink->reset = tar_sink_reset;
+    sink->reserve = tar_sink_reserve;
+    sink->finish = tar_sink_finish;
+    sink->abort = tar_sink_abort;
+    sink->ctx = t;
+    return ESP_OK;
+}
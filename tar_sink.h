@@ -0,0 +1,22 @@
+#ifndef TAR_SINK_H
+#define TAR_SINK_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "https_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Set up `sink` to extract a ustar archive on the fly, writing each regular
+// member to dest_dir/<member path>. With gunzip the stream is a .tar.gz.
+// Directories, links and pax/GNU extension records are skipped.
+// The sink's finish/abort release everything allocated here.
+esp_err_t tar_sink_init(download_sink_t *sink, const char *dest_dir, bool gunzip);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TAR_SINK_H
@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""Convert a trace ring dump (see trace.h) into Chrome trace JSON.
+
+    python3 tools/trace_to_chrome.py trace.bin > trace.json
+
+Open the result in chrome://tracing or https://ui.perfetto.dev. Each task is
+shown as its own thread (the core an event ran on is in its args), so network
+reads and flash writes that overlap (or don't) line up on one timeline.
+"""
+import json
+import struct
+import sys
+
+HEADER = struct.Struct("<IHBBII")
+EVENT = struct.Struct("<IBBBBI")
+MAGIC = 0x52544C44
+TASK_OTHER = 0xFF
+
+
+def convert(data):
+    magic, version, name_count, task_count, event_count, dropped = HEADER.unpack_from(data, 0)
+    if magic != MAGIC or version != 2:
+        raise ValueError("not a trace dump (magic %#x, version %d)" % (magic, version))
+
+    def strings(pos, count):
+        out = []
+        for _ in range(count):
+            end = data.index(b"\0", pos)
+            out.append(data[pos:end].decode(errors="replace"))
+            pos = end + 1
+        return out, pos
+
+    names, pos = strings(HEADER.size, name_count)
+    tasks, pos = strings(pos, task_count)
+
+    events = [
+        {"name": "thread_name", "ph": "M", "pid": 0, "tid": tid, "args": {"name": name}}
+        for tid, name in enumerate(tasks)
+    ]
+    events.append({"name": "thread_name", "ph": "M", "pid": 0, "tid": TASK_OTHER,
+                   "args": {"name": "other tasks"}})
+    last_ts = None
+    wrap = 0
+    for _ in range(event_count):
+        ts, ident, phase, core, task, arg = EVENT.unpack_from(data, pos)
+        pos += EVENT.size
+        # 32-bit timestamps wrap every ~71 min; small steps back are cross-core races
+        if last_ts is not None and ts + wrap < last_ts - (1 << 31):
+            wrap += 1 << 32
+        last_ts = ts + wrap
+        event = {
+            "name": names[ident] if ident < len(names) else "id%d" % ident,
+            "ph": chr(phase),
+            "ts": ts + wrap,
+            "pid": 0,
+            "tid": task,
+            "args": {"arg": arg, "core": core},
+        }
+        if event["ph"] == "i":
+            event["s"] = "t"
+        events.append(event)
+
+    return {
+        "traceEvents": events,
+        "displayTimeUnit": "ms",
+        "otherData": {"dropped_events": dropped},
+    }
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: %s trace.bin > trace.json" % sys.argv[0])
+    with open(sys.argv[1], "rb") as f:
+        trace = convert(f.read())
+    json.dump(trace, sys.stdout, indent=1)
+    sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,143 @@
+#include "trace.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "TRACE";
+
+#define TRACE_MAGIC    0x52544C44   // "DLTR"
+#define TRACE_VERSION  2
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t name_count;
+    uint8_t task_count;
+    uint32_t event_count;
+    uint32_t dropped;               // Overwritten before the dump
+} trace_file_header_t;
+
+static const char *const trace_names[TRACE_ID_COUNT] = {
+    [TRACE_HTTP_EVENT]  = "http_event",
+    [TRACE_NET_READ]    = "net_read",
+    [TRACE_MEMCPY]      = "memcpy",
+    [TRACE_FLUSH]       = "flush",
+    [TRACE_SPIFFS_INFO] = "spiffs_info",
+    [TRACE_SPIFFS_GC]   = "spiffs_gc",
+    [TRACE_BACKOFF]     = "backoff",
+    [TRACE_RATE_LIMIT]  = "rate_limit",
+    [TRACE_WIFI_EVENT]  = "wifi_event",
+};
+
+#if TRACE_ENABLED
+static trace_event_t ring[TRACE_RING_EVENTS];
+#else
+static trace_event_t ring[1];
+#endif
+static uint32_t head = 0;          // Total events ever recorded
+enum { TASK_SLOT_FREE, TASK_SLOT_CLAIMED, TASK_SLOT_READY };
+static uint8_t task_state[TRACE_MAX_TASKS];
+static char task_names[TRACE_MAX_TASKS][16];  // Copied at claim time: the task may be gone by the dump
+
+// Stable small id per task name. Keyed by name, not handle: the download tasks
+// are recreated for every download and must land on the same slot (and track)
+// each time instead of using up the table.
+static uint8_t trace_task_index(void)
+{
+    const char *name = pcTaskGetName(NULL);
+    for (uint8_t i = 0; i < TRACE_MAX_TASKS; i++) {
+        uint8_t state = __atomic_load_n(&task_state[i], __ATOMIC_ACQUIRE);
+        if (state == TASK_SLOT_READY && strncmp(task_names[i], name, sizeof(task_names[i]) - 1) == 0) {
+            return i;
+        }
+        if (state == TASK_SLOT_FREE) {
+            uint8_t expected = TASK_SLOT_FREE;
+            if (__atomic_compare_exchange_n(&task_state[i], &expected, TASK_SLOT_CLAIMED, false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                snprintf(task_names[i], sizeof(task_names[i]), "%s", name);
+                __atomic_store_n(&task_state[i], TASK_SLOT_READY, __ATOMIC_RELEASE);
+                return i;
+            }
+        }
+    }
+    return TRACE_TASK_OTHER;
+}
+
+void trace_record(trace_id_t id, trace_phase_t phase, uint32_t arg)
+{
+    // Lock-free slot claim, so tasks on either core can record
+    uint32_t idx = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED);
+    trace_event_t *e = &ring[idx % (sizeof(ring) / sizeof(ring[0]))];
+    e->ts_us = (uint32_t)esp_timer_get_time();
+    e->id = (uint8_t)id;
+    e->phase = (uint8_t)phase;
+    e->core = (uint8_t)xPortGetCoreID();
+    e->task = trace_task_index();
+    e->arg = arg;
+}
+
+esp_err_t trace_dump(const char *path)
+{
+    if (!TRACE_ENABLED) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    // Events recorded while dumping may tear a slot; good enough for a snapshot
+    uint32_t end = __atomic_load_n(&head, __ATOMIC_RELAXED);
+    uint32_t capacity = sizeof(ring) / sizeof(ring[0]);
+    uint32_t count = end < capacity ? end : capacity;
+    uint32_t start = end - count;
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        ESP_LOGE(TAG, "❌ Failed to open %s", path);
+        return ESP_FAIL;
+    }
+
+    uint8_t task_count = 0;
+    while (task_count < TRACE_MAX_TASKS &&
+           __atomic_load_n(&task_state[task_count], __ATOMIC_ACQUIRE) == TASK_SLOT_READY) {
+        task_count++;
+    }
+
+    trace_file_header_t hdr = {
+        .magic = TRACE_MAGIC,
+        .version = TRACE_VERSION,
+        .name_count = TRACE_ID_COUNT,
+        .task_count = task_count,
+        .event_count = count,
+        .dropped = start,
+    };
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    for (int i = 0; ok && i < TRACE_ID_COUNT; i++) {
+        ok = fwrite(trace_names[i], strlen(trace_names[i]) + 1, 1, f) == 1;
+    }
+    for (uint8_t i = 0; ok && i < task_count; i++) {
+        ok = fputs(task_names[i], f) >= 0 && fputc('\0', f) != EOF;
+    }
+
+    // Oldest first: the part after the write position, then the part before it
+    uint32_t first = start % capacity;
+    uint32_t tail = capacity - first < count ? capacity - first : count;
+    if (ok && tail > 0) {
+        ok = fwrite(&ring[first], sizeof(trace_event_t), tail, f) == tail;
+    }
+    if (ok && count > tail) {
+        ok = fwrite(&ring[0], sizeof(trace_event_t), count - tail, f) == count - tail;
+    }
+    if (fclose(f) != 0) {
+        ok = false;
+    }
+
+    if (!ok) {
+        ESP_LOGE(TAG, "❌ Failed to write %s", path);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "🧵 Wrote %u trace events to %s (%u overwritten)",
+             (unsigned)count, path, (unsigned)start);
+    return ESP_OK;
+}
@@ -0,0 +1,70 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Build with -DTRACE_ENABLED=1 to record; otherwise the macros compile to nothing
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 0
+#endif
+
+#define TRACE_RING_EVENTS 1024          // 12 bytes each; oldest events are overwritten
+#define TRACE_MAX_TASKS   16            // Task names told apart in a dump; later ones share TRACE_TASK_OTHER
+#define TRACE_TASK_OTHER  0xff
+
+typedef enum {
+    TRACE_HTTP_EVENT,       // Instant, arg = esp_http_client_event_id_t
+    TRACE_NET_READ,         // Pull-mode esp_http_client_read(), arg = bytes
+    TRACE_MEMCPY,           // Event-mode copy into the write buffer, arg = bytes
+    TRACE_FLUSH,            // flush_write_buffer(), arg = bytes
+    TRACE_SPIFFS_INFO,      // esp_spiffs_info()
+    TRACE_SPIFFS_GC,        // esp_spiffs_gc(), arg = bytes
+    TRACE_BACKOFF,          // Retry sleep, arg = ms
+    TRACE_RATE_LIMIT,       // Token bucket sleep, arg = us
+    TRACE_WIFI_EVENT,       // Instant, arg = wifi_event_t or IP_EVENT_STA_GOT_IP | 0x100
+    TRACE_ID_COUNT
+} trace_id_t;
+
+typedef enum {
+    TRACE_PHASE_BEGIN = 'B',
+    TRACE_PHASE_END = 'E',
+    TRACE_PHASE_INSTANT = 'i',
+} trace_phase_t;
+
+// Events are keyed by task, not core: an unpinned task may migrate between its
+// B and E, and the pair must still land on one track
+typedef struct {
+    uint32_t ts_us;         // Low 32 bits of esp_timer_get_time(); the converter unwraps
+    uint8_t id;             // trace_id_t
+    uint8_t phase;          // trace_phase_t
+    uint8_t core;
+    uint8_t task;           // Index into the dump's task table, or TRACE_TASK_OTHER
+    uint32_t arg;
+} trace_event_t;
+
+void trace_record(trace_id_t id, trace_phase_t phase, uint32_t arg);
+
+// Write the ring to `path`: a header, the event names, the task names, then the
+// events oldest first. tools/trace_to_chrome.py turns the file into Chrome trace JSON.
+esp_err_t trace_dump(const char *path);
+
+#if TRACE_ENABLED
+#define TRACE_BEGIN(id, arg)   trace_record((id), TRACE_PHASE_BEGIN, (uint32_t)(arg))
+#define TRACE_END(id, arg)     trace_record((id), TRACE_PHASE_END, (uint32_t)(arg))
+#define TRACE_INSTANT(id, arg) trace_record((id), TRACE_PHASE_INSTANT, (uint32_t)(arg))
+#else
+#define TRACE_BEGIN(id, arg)   do { } while (0)
+#define TRACE_END(id, arg)     do { } while (0)
+#define TRACE_INSTANT(id, arg) do { } while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACE_H
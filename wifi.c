@@ -2,39 +2,196 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 #include "esp_wifi.h"
+#include "esp_mac.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
+#include "nvs.h"
 #include "wifi.h"
+#include "metrics.h"
+#include "hot_log.h"
+#include "trace.h"
 
 #define WIFI_SSID "KRISHNA LIBRARY" // Change as needed
 #define WIFI_PASS "Dwarkadhish@0706" // Change as needed
-#define WIFI_CONNECTED_BIT BIT0
 
 static const char *TAG = "WIFI_TASK";
 EventGroupHandle_t wifi_event_group;
+static esp_netif_t *sta_netif = NULL;
+static int64_t ready_time_us = 0;
+
+// 🚀 Fast reconnect: last good AP and lease, persisted in NVS
+#define WIFI_CACHE_NAMESPACE       "wifi_cache"
+#define WIFI_CACHE_KEY             "ap"
+#define WIFI_CACHE_VERSION         1
+#define WIFI_FAST_CONNECT_RETRIES  2     // Directed attempts before falling back to full scan
+#define WIFI_USE_CACHED_IP         0     // 1 = skip DHCP and reuse the last lease (static-IP networks)
+#define WIFI_WARN_INTERVAL_MS      10000 // A flapping link logs its disconnects at most once per 10 sec
+
+typedef struct {
+    uint32_t version;
+    uint8_t bssid[6];
+    uint8_t channel;
+    esp_netif_ip_info_t ip_info;
+    esp_netif_dns_info_t dns;
+} wifi_cache_t;
+
+static wifi_cache_t cache;
+static bool cache_valid = false;
+static bool fast_connect = false;          // Current config is directed at the cached AP
+static bool static_ip = false;             // DHCP is stopped and cached lease applied
+static int fast_connect_failures = 0;
+static int64_t connect_start_us = 0;
+
+METRIC_DEFINE(m_connects, "wifi_connects_total", METRIC_TYPE_COUNTER, "IP acquisitions");
+METRIC_DEFINE(m_disconnects, "wifi_disconnects_total", METRIC_TYPE_COUNTER, "Station disconnect events");
+METRIC_DEFINE(m_fallbacks, "wifi_fast_connect_fallbacks_total", METRIC_TYPE_COUNTER,
+              "Cached-AP connects that fell back to a full scan");
+METRIC_DEFINE(m_connect_us, "wifi_connect_latency_us", METRIC_TYPE_HISTOGRAM,
+              "Connect attempt start to IP address");
+
+static void wifi_cache_load(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(WIFI_CACHE_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    size_t len = sizeof(cache);
+    if (nvs_get_blob(nvs, WIFI_CACHE_KEY, &cache, &len) == ESP_OK &&
+        len == sizeof(cache) && cache.version == WIFI_CACHE_VERSION && cache.channel != 0) {
+        cache_valid = true;
+    }
+    nvs_close(nvs);
+}
+
+static void wifi_cache_store(void)
+{
+    nvs_handle_t nvs;
+    cache.version = WIFI_CACHE_VERSION;
+    if (nvs_open(WIFI_CACHE_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    if (nvs_set_blob(nvs, WIFI_CACHE_KEY, &cache, sizeof(cache)) == ESP_OK) {
+        nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    cache_valid = true;
+}
+
+static void wifi_cache_erase(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(WIFI_CACHE_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        nvs_erase_key(nvs, WIFI_CACHE_KEY);
+        nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    cache_valid = false;
+}
+
+// Point the station config at the cached AP so the connect skips the scan
+static void wifi_direct_to_cache(wifi_config_t *wifi_config)
+{
+    memcpy(wifi_config->sta.bssid, cache.bssid, sizeof(cache.bssid));
+    wifi_config->sta.bssid_set = true;
+    wifi_config->sta.channel = cache.channel;
+    wifi_config->sta.scan_method = WIFI_FAST_SCAN;
+    fast_connect = true;
+    fast_connect_failures = 0;
+}
+
+// Give up on the cached AP: scan for the SSID again and go back to DHCP
+static void wifi_fall_back_to_full_scan(void)
+{
+    ESP_LOGW(TAG, "⚠️ Fast connect failed, falling back to full scan");
+    metric_counter_add(&m_fallbacks, 1);
+    wifi_config_t wifi_config;
+    esp_wifi_get_config(WIFI_IF_STA, &wifi_config);
+    wifi_config.sta.bssid_set = false;
+    wifi_config.sta.channel = 0;
+    wifi_config.sta.scan_method = WIFI_FAST_SCAN;  // Same default scan as a cold boot
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+
+    if (static_ip) {
+        esp_netif_dhcpc_start(sta_netif);
+        static_ip = false;
+    }
+    fast_connect = false;
+    wifi_cache_erase();
+}
 
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                               int32_t event_id, void* event_data) {
+    TRACE_INSTANT(TRACE_WIFI_EVENT, event_base == IP_EVENT ? event_id | 0x100 : event_id);
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        ESP_LOGI(TAG, "Wi-Fi started, trying to connect to SSID: %s", WIFI_SSID);
+        ESP_LOGI(TAG, "Wi-Fi started, trying to connect to SSID: %s (%s)",
+                 WIFI_SSID, fast_connect ? "fast connect" : "full scan");
+        connect_start_us = esp_timer_get_time();
         esp_wifi_connect();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        wifi_event_sta_connected_t *event = (wifi_event_sta_connected_t *) event_data;
+        fast_connect_failures = 0;
+        if (memcmp(cache.bssid, event->bssid, sizeof(cache.bssid)) != 0 ||
+            cache.channel != event->channel) {
+            memcpy(cache.bssid, event->bssid, sizeof(cache.bssid));
+            cache.channel = event->channel;
+            cache_valid = false;        // Lease is stored once we get an IP
+        }
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        ESP_LOGW(TAG, "Wi-Fi disconnected! Retrying...");
+        LOG_RATELIMIT_W(WIFI_WARN_INTERVAL_MS, TAG, "Wi-Fi disconnected! Retrying...");
+        metric_counter_add(&m_disconnects, 1);
+        xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT | WIFI_DNS_READY_BIT);
+        if (fast_connect && ++fast_connect_failures >= WIFI_FAST_CONNECT_RETRIES) {
+            wifi_fall_back_to_full_scan();
+        } else if (!fast_connect && cache_valid) {
+            // The AP we last got a lease from (possibly learned by a full scan) is the best bet
+            wifi_config_t wifi_config;
+            esp_wifi_get_config(WIFI_IF_STA, &wifi_config);
+            wifi_direct_to_cache(&wifi_config);
+            esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+            ESP_LOGI(TAG, "Reconnecting to cached AP " MACSTR " on channel %d",
+                     MAC2STR(cache.bssid), cache.channel);
+        }
+        connect_start_us = esp_timer_get_time();
         esp_wifi_connect();
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-        ESP_LOGI(TAG, "✅ Wi-Fi connected successfully!");
+        int64_t connect_us = esp_timer_get_time() - connect_start_us;
+        ESP_LOGI(TAG, "✅ Wi-Fi connected successfully in %lld ms!", connect_us / 1000);
+        metric_counter_add(&m_connects, 1);
+        metric_histogram_observe(&m_connect_us, (uint32_t)connect_us);
         ESP_LOGI(TAG, "📡 Got IP Address: " IPSTR, IP2STR(&event->ip_info.ip));
-        xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
+        if (ready_time_us == 0) {
+            ready_time_us = esp_timer_get_time();
+        }
+
+        // DHCP options arrive together with the lease, so DNS is known by now
+        EventBits_t bits = WIFI_CONNECTED_BIT;
+        esp_netif_dns_info_t dns = {0};
+        if (esp_netif_get_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK &&
+            dns.ip.u_addr.ip4.addr != 0) {
+            bits |= WIFI_DNS_READY_BIT;
+        } else {
+            ESP_LOGW(TAG, "⚠️ No DNS server in DHCP lease");
+        }
+
+        // Only touch NVS when the AP or lease actually changed
+        if (!cache_valid || memcmp(&cache.ip_info, &event->ip_info, sizeof(cache.ip_info)) != 0 ||
+            memcmp(&cache.dns, &dns, sizeof(cache.dns)) != 0) {
+            cache.ip_info = event->ip_info;
+            cache.dns = dns;
+            wifi_cache_store();
+        }
+        xEventGroupSetBits(wifi_event_group, bits);
     }
 }
 
-void wifi_init_sta(void) {
+void wifi_start_sta(void) {
     wifi_event_group = xEventGroupCreate();
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    sta_netif = esp_netif_create_default_wifi_sta();
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
@@ -52,6 +209,21 @@ void wifi_init_sta(void) {
         },
     };
 
+    // 🚀 Directed connect to the last good AP skips the all-channel scan
+    wifi_cache_load();
+    if (cache_valid) {
+        wifi_direct_to_cache(&wifi_config);
+
+        if (WIFI_USE_CACHED_IP && cache.ip_info.ip.addr != 0) {
+            esp_netif_dhcpc_stop(sta_netif);
+            esp_netif_set_ip_info(sta_netif, &cache.ip_info);
+            esp_netif_set_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &cache.dns);
+            static_ip = true;
+        }
+        ESP_LOGI(TAG, "Using cached AP " MACSTR " on channel %d",
+                 MAC2STR(cache.bssid), cache.channel);
+    }
+
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
@@ -59,7 +231,11 @@ void wifi_init_sta(void) {
     // 🚀 Disable Wi-Fi power save to increase throughput
     ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_NONE));
 
-    ESP_LOGI(TAG, "Wi-Fi initialization complete. Waiting for connection...");
+    ESP_LOGI(TAG, "Wi-Fi initialization complete. Connecting in background...");
+}
+
+void wifi_init_sta(void) {
+    wifi_start_sta();
 
     // Block until Wi-Fi connected and IP address received
     xEventGroupWaitBits(
@@ -71,3 +247,24 @@ void wifi_init_sta(void) {
 
     ESP_LOGI(TAG, "Wi-Fi ready for network tasks.");
 }
+
+esp_err_t wifi_wait_ready(EventBits_t bits, uint32_t timeout_ms)
+{
+    if (wifi_event_group == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    EventBits_t got = xEventGroupWaitBits(
+        wifi_event_group,
+        bits,
+        pdFALSE,
+        pdTRUE,             // all requested bits
+        pdMS_TO_TICKS(timeout_ms));
+
+    return ((got & bits) == bits) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+int64_t wifi_get_ready_time_us(void)
+{
+    return ready_time_us;
+}
@@ -1,11 +1,25 @@
 #ifndef WIFI_H
 #define WIFI_H
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 
-extern EventGroupHandle_t s_wifi_event_group;
-#define WIFI_CONNECTED_BIT BIT0
+extern EventGroupHandle_t wifi_event_group;
+#define WIFI_CONNECTED_BIT BIT0     // Associated and got an IP address
+#define WIFI_DNS_READY_BIT BIT1     // DHCP handed us a usable DNS server
 
 
+// Start STA bring-up and return immediately; progress is signalled via wifi_event_group
+void wifi_start_sta(void);
+
+// Start STA bring-up and block until an IP address is obtained
 void wifi_init_sta(void);
 
+// Wait until all of `bits` are set in wifi_event_group.
+// Returns ESP_OK when ready, ESP_ERR_TIMEOUT otherwise.
+esp_err_t wifi_wait_ready(EventBits_t bits, uint32_t timeout_ms);
+
+// esp_timer timestamp (us since boot) of the first IP acquisition, 0 if none yet
+int64_t wifi_get_ready_time_us(void);
+
 #endif // WIFI_H